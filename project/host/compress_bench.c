@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "compress.h"
+
+// Runs per message, timings are averaged over all of them
+#define ROUNDS 2000
+
+typedef struct
+{
+    const char *name;
+    const char *const *msgs;
+    size_t count;
+} corpus_t;
+
+static const char *const greetings[] = {
+    "Hello, everyone!",
+    "Hello, Node 2!",
+    "Hello, Node 1!",
+    "Hello, Node 3!",
+    "Hello, Node 4!",
+};
+
+static const char *const key_value[] = {
+    "node=2 temp=23.5C hum=45.0%RH batt=3.71V",
+    "node=3 temp=22.0C hum=51.5%RH batt=3.69V",
+    "node=2 press=1013.2hPa rssi=-92dBm snr=7.5",
+    "node=4 water level=120mm soil=31.0% status=ok",
+    "node=5 door=open light=high alarm=off",
+    "node=1 batt=3.64V volt=3300mV status=error",
+};
+
+static const char *const json[] = {
+    "{\"id\":2,\"temp\":23.5,\"hum\":45.0}",
+    "{\"id\":3,\"temp\":22.0,\"hum\":51.5,\"batt\":3.69}",
+    "{\"id\":4,\"status\":\"ok\",\"seq\":1201}",
+    "{\"id\":5,\"door\":\"open\",\"alarm\":false}",
+    "{\"id\":1,\"lat\":1.3521,\"lon\":103.8198,\"alt\":15}",
+};
+
+static const char *const csv[] = {
+    "2,1201,23.5,45.0,3.71",
+    "3,1202,22.0,51.5,3.69",
+    "4,1203,21.5,60.0,3.70",
+    "5,1204,20.0,62.5,3.68",
+};
+
+#define CORPUS(n, m) { n, m, sizeof(m) / sizeof(m[0]) }
+
+static const corpus_t corpora[] = {
+    CORPUS("greetings", greetings),
+    CORPUS("key=value", key_value),
+    CORPUS("json", json),
+    CORPUS("csv", csv),
+};
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long long cycles()
+{
+#if HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Keeps the compiler from dropping the benchmarked calls
+static volatile size_t sink;
+
+static int bench_corpus(const codec_t *codec, const corpus_t *c)
+{
+    size_t raw_total = 0, enc_total = 0;
+    double enc_ns = 0, dec_ns = 0;
+    unsigned long long enc_cyc = 0, dec_cyc = 0;
+
+    for (size_t m = 0; m < c->count; m++)
+    {
+        const uint8_t *raw = (const uint8_t *)c->msgs[m];
+        size_t len = strlen(c->msgs[m]) + 1;
+        uint8_t enc[COMPRESS_MAX_RAW];
+        uint8_t dec[COMPRESS_MAX_RAW];
+
+        size_t n = codec->encode(raw, len, enc, sizeof(enc));
+        if (n == 0 || codec->decode(enc, n, dec, sizeof(dec)) != len || memcmp(dec, raw, len) != 0)
+        {
+            printf("round trip failed: \"%s\"\n", c->msgs[m]);
+            return 1;
+        }
+        raw_total += len;
+        enc_total += n;
+
+        double t = now_ns();
+        unsigned long long cy = cycles();
+        for (int r = 0; r < ROUNDS; r++)
+        {
+            sink = codec->encode(raw, len, enc, sizeof(enc));
+        }
+        enc_cyc += cycles() - cy;
+        enc_ns += now_ns() - t;
+
+        t = now_ns();
+        cy = cycles();
+        for (int r = 0; r < ROUNDS; r++)
+        {
+            sink = codec->decode(enc, n, dec, sizeof(dec));
+        }
+        dec_cyc += cycles() - cy;
+        dec_ns += now_ns() - t;
+    }
+
+    double runs = (double)ROUNDS * c->count;
+    printf("%-10s %5zu %6zu %6zu %6.2f %9.0f %9.0f", c->name, c->count, raw_total, enc_total,
+           (double)enc_total / raw_total, enc_ns / runs, dec_ns / runs);
+    if (HAVE_TSC)
+    {
+        printf(" %10.0f %10.0f", enc_cyc / runs, dec_cyc / runs);
+    }
+    printf("\n");
+    return 0;
+}
+
+int main()
+{
+    const codec_t *codec = &codec_dict_lz;
+    int failed = 0;
+
+    printf("codec: %s, %d rounds per message, sizes include the terminating NUL\n\n", codec->name, ROUNDS);
+    printf("%-10s %5s %6s %6s %6s %9s %9s", "corpus", "msgs", "raw", "comp", "ratio", "enc ns", "dec ns");
+    if (HAVE_TSC)
+    {
+        printf(" %10s %10s", "enc cyc", "dec cyc");
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++)
+    {
+        failed |= bench_corpus(codec, &corpora[i]);
+    }
+
+    return failed;
+}
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "mock_hal.h"
+#include "ssd1306.h"
+
+// The SDK stand-in turns printf into sim_printf, lines reach stdout through host_log
+
+#define DISPLAY_WIDTH 128
+#define DISPLAY_HEIGHT 64
+#define DISPLAY_ADDR 0x3C
+#define DISPLAY_BAUD 400000
+
+// Every case runs in batches until this much time has passed
+#define MIN_RUN_NS 50e6
+#define FIRST_BATCH 16
+
+/* ------------------------------------------------------------------------ */
+/* Host for the SDK stand-in, time only moves when the driver waits         */
+/* ------------------------------------------------------------------------ */
+
+static uint64_t clock_us;
+static size_t i2c_bytes;
+
+static uint64_t host_now(void *ctx)
+{
+    (void)ctx;
+    return clock_us;
+}
+
+static void host_wait(void *ctx, uint64_t us)
+{
+    (void)ctx;
+    clock_us += us ? us : 1;
+}
+
+static void host_gpio_out(void *ctx, unsigned pin, bool level)
+{
+    (void)ctx;
+    (void)pin;
+    (void)level;
+}
+
+static void host_uart_baud(void *ctx, unsigned baud)
+{
+    (void)ctx;
+    (void)baud;
+}
+
+static void host_uart_tx(void *ctx, uint8_t byte)
+{
+    (void)ctx;
+    (void)byte;
+}
+
+static bool host_i2c_write(void *ctx, uint8_t addr, const uint8_t *data, size_t len)
+{
+    (void)ctx;
+    (void)data;
+    i2c_bytes += len;
+    return addr == DISPLAY_ADDR;
+}
+
+static void host_log(void *ctx, const char *line)
+{
+    (void)ctx;
+    puts(line);
+}
+
+static const sim_host_t host = {
+    .ctx = NULL,
+    .now_us = host_now,
+    .wait = host_wait,
+    .gpio_out = host_gpio_out,
+    .uart_baud = host_uart_baud,
+    .uart_tx = host_uart_tx,
+    .i2c_write = host_i2c_write,
+    .log = host_log,
+};
+
+/* ------------------------------------------------------------------------ */
+/* Cases                                                                    */
+/* ------------------------------------------------------------------------ */
+
+typedef struct bench_case bench_case_t;
+
+struct bench_case
+{
+    const char *name;
+    const char *args;
+    void (*draw)(ssd1306_t *p, const bench_case_t *c, uint32_t i);
+    int32_t a, b, c, d;
+    const char *text;
+};
+
+// Monochrome BMP files drawn by the bmp cases, filled in by make_bmp
+#define BMP_MAX_SIZE (62 + 128 * 64 / 8)
+
+typedef struct
+{
+    uint8_t data[BMP_MAX_SIZE];
+    long size;
+} bmp_t;
+
+static bmp_t bmps[3];
+
+static void put_le(uint8_t *d, uint32_t v, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        d[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+// Bottom-up 1 bit BMP with a black/white palette and a diagonal stripe pattern
+static void make_bmp(bmp_t *b, uint32_t width, uint32_t height)
+{
+    uint32_t stride = ((width + 31) / 32) * 4;
+    uint32_t off = 14 + 40 + 8;
+
+    memset(b->data, 0, sizeof(b->data));
+    b->data[0] = 'B';
+    b->data[1] = 'M';
+    put_le(b->data + 2, off + stride * height, 4);
+    put_le(b->data + 10, off, 4);
+    put_le(b->data + 14, 40, 4);
+    put_le(b->data + 18, width, 4);
+    put_le(b->data + 22, height, 4);
+    put_le(b->data + 26, 1, 2);
+    put_le(b->data + 28, 1, 2);
+    put_le(b->data + 54, 0x000000, 4);
+    put_le(b->data + 58, 0xFFFFFF, 4);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            if (((x + y) & 7) < 3)
+            {
+                b->data[off + y * stride + (x >> 3)] |= 0x80 >> (x & 7);
+            }
+        }
+    }
+    b->size = off + stride * height;
+}
+
+static void draw_pixel(ssd1306_t *p, const bench_case_t *c, uint32_t i)
+{
+    (void)c;
+    ssd1306_draw_pixel(p, (i * 7) % DISPLAY_WIDTH, (i * 3) % DISPLAY_HEIGHT);
+}
+
+static void draw_line(ssd1306_t *p, const bench_case_t *c, uint32_t i)
+{
+    (void)i;
+    ssd1306_draw_line(p, c->a, c->b, c->c, c->d);
+}
+
+static void draw_square(ssd1306_t *p, const bench_case_t *c, uint32_t i)
+{
+    (void)i;
+    ssd1306_draw_square(p, c->a, c->b, c->c, c->d);
+}
+
+static void draw_empty_square(ssd1306_t *p, const bench_case_t *c, uint32_t i)
+{
+    (void)i;
+    ssd1306_draw_empty_square(p, c->a, c->b, c->c, c->d);
+}
+
+static void draw_char(ssd1306_t *p, const bench_case_t *c, uint32_t i)
+{
+    ssd1306_draw_char(p, c->a, c->b, c->c, (char)('A' + i % 26));
+}
+
+static void draw_string(ssd1306_t *p, const bench_case_t *c, uint32_t i)
+{
+    (void)i;
+    ssd1306_draw_string(p, c->a, c->b, c->c, c->text);
+}
+
+static void draw_bmp(ssd1306_t *p, const bench_case_t *c, uint32_t i)
+{
+    (void)i;
+    ssd1306_bmp_show_image_with_offset(p, bmps[c->c].data, bmps[c->c].size, c->a, c->b);
+}
+
+static const bench_case_t cases[] = {
+    { "pixel", "spread", draw_pixel, 0, 0, 0, 0, NULL },
+    { "line", "horiz 32", draw_line, 0, 10, 31, 10, NULL },
+    { "line", "horiz 128", draw_line, 0, 10, 127, 10, NULL },
+    { "line", "vert 64", draw_line, 10, 0, 10, 63, NULL },
+    { "line", "diag 128x64", draw_line, 0, 0, 127, 63, NULL },
+    { "line", "steep 16x64", draw_line, 0, 0, 15, 63, NULL },
+    { "square", "4x4", draw_square, 8, 8, 4, 4, NULL },
+    { "square", "16x16", draw_square, 8, 8, 16, 16, NULL },
+    { "square", "64x32", draw_square, 8, 8, 64, 32, NULL },
+    { "square", "128x64", draw_square, 0, 0, 128, 64, NULL },
+    { "empty_square", "127x63", draw_empty_square, 0, 0, 127, 63, NULL },
+    { "char", "scale 1", draw_char, 8, 8, 1, 0, NULL },
+    { "char", "scale 1 y+3", draw_char, 8, 11, 1, 0, NULL },
+    { "char", "scale 2", draw_char, 8, 8, 2, 0, NULL },
+    { "char", "scale 3 y+5", draw_char, 8, 13, 3, 0, NULL },
+    { "char", "scale 4", draw_char, 8, 8, 4, 0, NULL },
+    { "string", "14 chars x1", draw_string, 0, 8, 1, 0, "Hello, Node 2!" },
+    { "string", "21 chars x1", draw_string, 0, 8, 1, 0, "Node 3: temp=23.5 ok!" },
+    { "string", "edge y+6", draw_string, 100, 62, 1, 0, "clipped" },
+    { "string", "10 chars x2", draw_string, 0, 8, 2, 0, "CONFIG OK!" },
+    { "bmp", "16x16", draw_bmp, 8, 8, 0, 0, NULL },
+    { "bmp", "64x32", draw_bmp, 8, 8, 1, 0, NULL },
+    { "bmp", "128x64", draw_bmp, 0, 0, 2, 0, NULL },
+};
+
+/* ------------------------------------------------------------------------ */
+/* Measurement                                                              */
+/* ------------------------------------------------------------------------ */
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long long cycles()
+{
+#if HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// FNV-1a of the display buffer, changes whenever a primitive renders differently
+static uint32_t buffer_hash(const ssd1306_t *p)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < p->bufsize; i++)
+    {
+        h = (h ^ p->buffer[i]) * 16777619u;
+    }
+    return h;
+}
+
+static size_t buffer_set_bytes(const ssd1306_t *p)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < p->bufsize; i++)
+    {
+        n += p->buffer[i] != 0;
+    }
+    return n;
+}
+
+static void bench_case(ssd1306_t *p, const bench_case_t *c)
+{
+    // Bytes touched by one call on a blank display and what the next show sends for it
+    ssd1306_clear(p);
+    ssd1306_show(p);
+    c->draw(p, c, 0);
+    size_t changed = buffer_set_bytes(p);
+    size_t window = p->dirty_x1 > p->dirty_x2 ? 0 :
+                    (size_t)(p->dirty_x2 - p->dirty_x1 + 1) * (p->dirty_p2 - p->dirty_p1 + 1);
+    uint32_t hash = buffer_hash(p);
+    i2c_bytes = 0;
+    ssd1306_show(p);
+    size_t sent = i2c_bytes;
+
+    uint32_t ops = 0;
+    uint32_t batch = FIRST_BATCH;
+    double ns = 0;
+    unsigned long long cyc = 0;
+
+    while (ns < MIN_RUN_NS)
+    {
+        double t = now_ns();
+        unsigned long long cy = cycles();
+        for (uint32_t i = 0; i < batch; i++)
+        {
+            c->draw(p, c, ops + i);
+        }
+        cyc += cycles() - cy;
+        ns += now_ns() - t;
+        ops += batch;
+        batch *= 2;
+    }
+
+    printf("%-12s %-12s %10.1f", c->name, c->args, ns / ops);
+    if (HAVE_TSC)
+    {
+        printf(" %10.0f", (double)cyc / ops);
+    }
+    printf(" %7zu %7zu %7zu %10.2f  %08x\n", changed, window, sent, changed ? ns / ops / changed : 0.0,
+           (unsigned)hash);
+}
+
+static void usage(const char *prog)
+{
+    printf("usage: %s [-f name]\n", prog);
+    printf("  -f name  only run cases whose primitive is name (pixel, line, square, empty_square,\n");
+    printf("           char, string, bmp)\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return strcmp(argv[i], "-h") == 0 ? 0 : 1;
+        }
+    }
+
+    make_bmp(&bmps[0], 16, 16);
+    make_bmp(&bmps[1], 64, 32);
+    make_bmp(&bmps[2], 128, 64);
+
+    mock_hal_attach(&host);
+    i2c_init(i2c1, DISPLAY_BAUD);
+
+    ssd1306_t disp;
+    disp.external_vcc = false;
+    if (!ssd1306_init(&disp, DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_ADDR, i2c1))
+    {
+        printf("display init failed\n");
+        return 1;
+    }
+
+    printf("%dx%d display, ns and cycles per call, bytes for one call on a blank buffer:\n", DISPLAY_WIDTH,
+           DISPLAY_HEIGHT);
+    printf("changed = buffer bytes with pixels set, window = dirty window, i2c = bytes the next show sends\n\n");
+    printf("%-12s %-12s %10s", "primitive", "case", "ns/op");
+    if (HAVE_TSC)
+    {
+        printf(" %10s", "cyc/op");
+    }
+    printf(" %7s %7s %7s %10s  %8s\n", "changed", "window", "i2c", "ns/byte", "hash");
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        if (!filter || strcmp(filter, cases[i].name) == 0)
+        {
+            bench_case(&disp, &cases[i]);
+        }
+    }
+
+    ssd1306_deinit(&disp);
+    return 0;
+}
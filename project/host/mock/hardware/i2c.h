@@ -0,0 +1,68 @@
+#ifndef MOCK_HARDWARE_I2C_H
+#define MOCK_HARDWARE_I2C_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+// DW_apb_i2c registers, writes to data_cmd only reach the bus through DMA in the model
+typedef struct
+{
+    volatile uint32_t con;
+    volatile uint32_t tar;
+    volatile uint32_t sar;
+    uint32_t _pad0;
+    volatile uint32_t data_cmd;
+    volatile uint32_t ss_scl_hcnt;
+    volatile uint32_t ss_scl_lcnt;
+    volatile uint32_t fs_scl_hcnt;
+    volatile uint32_t fs_scl_lcnt;
+    uint32_t _pad1[2];
+    volatile uint32_t intr_stat;
+    volatile uint32_t intr_mask;
+    volatile uint32_t raw_intr_stat;
+    volatile uint32_t rx_tl;
+    volatile uint32_t tx_tl;
+    volatile uint32_t clr_intr;
+    volatile uint32_t clr_rx_under;
+    volatile uint32_t clr_rx_over;
+    volatile uint32_t clr_tx_over;
+    volatile uint32_t clr_rd_req;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t clr_rx_done;
+    volatile uint32_t clr_activity;
+    volatile uint32_t clr_stop_det;
+    volatile uint32_t clr_start_det;
+    volatile uint32_t clr_gen_call;
+    volatile uint32_t enable;
+    volatile uint32_t status;
+    volatile uint32_t txflr;
+    volatile uint32_t rxflr;
+    volatile uint32_t sda_hold;
+    volatile uint32_t tx_abrt_source;
+} i2c_hw_t;
+
+typedef struct i2c_inst i2c_inst_t;
+
+extern i2c_inst_t mock_i2c0_inst;
+extern i2c_inst_t mock_i2c1_inst;
+
+#define i2c0 (&mock_i2c0_inst)
+#define i2c1 (&mock_i2c1_inst)
+
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x00000200
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us);
+uint i2c_get_index(i2c_inst_t *i2c);
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c);
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx);
+
+#endif
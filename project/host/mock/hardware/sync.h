@@ -0,0 +1,27 @@
+#ifndef MOCK_HARDWARE_SYNC_H
+#define MOCK_HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+// Interrupts of a simulated node only run while its main code waits, a compiler barrier is enough
+static inline void __dmb(void)
+{
+    __asm__ volatile("" ::: "memory");
+}
+
+// Core 1 does not exist in the simulation, events are never waited for
+static inline void __sev(void)
+{
+}
+
+static inline void __wfe(void)
+{
+}
+
+// Hands the time to the other nodes until an interrupt is pending or has run, also with interrupts disabled
+void __wfi(void);
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#endif
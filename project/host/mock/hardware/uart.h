@@ -0,0 +1,75 @@
+#ifndef MOCK_HARDWARE_UART_H
+#define MOCK_HARDWARE_UART_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+// PL011 registers, only fr and rsr carry state in the model
+typedef struct
+{
+    volatile uint32_t dr;
+    volatile uint32_t rsr;
+    uint32_t _pad0[4];
+    volatile uint32_t fr;
+    uint32_t _pad1;
+    volatile uint32_t ilpr;
+    volatile uint32_t ibrd;
+    volatile uint32_t fbrd;
+    volatile uint32_t lcr_h;
+    volatile uint32_t cr;
+    volatile uint32_t ifls;
+    volatile uint32_t imsc;
+    volatile uint32_t ris;
+    volatile uint32_t mis;
+    volatile uint32_t icr;
+    volatile uint32_t dmacr;
+} uart_hw_t;
+
+typedef struct uart_inst uart_inst_t;
+
+extern uart_inst_t mock_uart0_inst;
+extern uart_inst_t mock_uart1_inst;
+
+#define uart0 (&mock_uart0_inst)
+#define uart1 (&mock_uart1_inst)
+
+#define UART0_IRQ 20
+#define UART1_IRQ 21
+
+#define UART_UARTRSR_OE_BITS 0x00000008
+#define UART_UARTRSR_BE_BITS 0x00000004
+#define UART_UARTRSR_PE_BITS 0x00000002
+#define UART_UARTRSR_FE_BITS 0x00000001
+
+#define UART_UARTFR_TXFE_BITS 0x00000080
+#define UART_UARTFR_RXFF_BITS 0x00000040
+#define UART_UARTFR_TXFF_BITS 0x00000020
+#define UART_UARTFR_RXFE_BITS 0x00000010
+#define UART_UARTFR_BUSY_BITS 0x00000008
+
+typedef enum
+{
+    UART_PARITY_NONE,
+    UART_PARITY_EVEN,
+    UART_PARITY_ODD
+} uart_parity_t;
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+void uart_deinit(uart_inst_t *uart);
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate);
+void uart_set_hw_flow(uart_inst_t *uart, bool cts, bool rts);
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity);
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data);
+uint uart_get_index(uart_inst_t *uart);
+uart_hw_t *uart_get_hw(uart_inst_t *uart);
+bool uart_is_writable(uart_inst_t *uart);
+bool uart_is_readable(uart_inst_t *uart);
+void uart_putc_raw(uart_inst_t *uart, char c);
+char uart_getc(uart_inst_t *uart);
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len);
+void uart_read_blocking(uart_inst_t *uart, uint8_t *dst, size_t len);
+
+#endif
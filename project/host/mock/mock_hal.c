@@ -0,0 +1,822 @@
+/**
+*   Stand-in for the Pico SDK functions used by the firmware.
+*
+*   Time, pins and bytes are exchanged with the simulation through sim_host_t.
+*   The UART keeps the PL011 FIFO depths and byte timing so the interrupt driven
+*   driver sees the same levels as on the board, transfers started by DMA into
+*   an I2C data_cmd register are handed to the bus model in one piece and the
+*   channel stays busy for as long as the transfer would take at the bus speed.
+*
+*   Interrupts only run when the node gives the time back (mock_hal_tick is
+*   called between two steps of the node), never in the middle of its code.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "hardware/dma.h"
+#include "hardware/flash.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "mock_hal.h"
+
+#define UART_FIFO_DEPTH 32
+
+// FIFO levels the UART interrupts trigger at, RX also fires after 32 idle bit times
+#define UART_RX_IRQ_LEVEL 4
+#define UART_TX_IRQ_LEVEL 4
+
+#define IO_IRQ_BANK0 13
+#define USBCTRL_IRQ 5
+
+// Console text waiting to be read, more is dropped
+#define CONSOLE_IN_SIZE 256
+
+static const sim_host_t *host;
+
+static void raise_irq(uint num);
+
+static uint64_t now()
+{
+    return host->now_us(host->ctx);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Time and stdio                                                           */
+/* ------------------------------------------------------------------------ */
+
+uint32_t time_us_32()
+{
+    return (uint32_t)now();
+}
+
+uint64_t time_us_64()
+{
+    return now();
+}
+
+void sleep_us(uint64_t us)
+{
+    host->wait(host->ctx, us);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sleep_us((uint64_t)ms * 1000);
+}
+
+void busy_wait_us(uint64_t us)
+{
+    sleep_us(us);
+}
+
+void tight_loop_contents()
+{
+    host->wait(host->ctx, 0);
+}
+
+absolute_time_t make_timeout_time_us(uint64_t us)
+{
+    return now() + us;
+}
+
+bool stdio_init_all()
+{
+    return true;
+}
+
+void stdio_flush()
+{
+}
+
+// Free running indices, written by the simulation and read by the node
+static char console_in[CONSOLE_IN_SIZE];
+static size_t console_head = 0;
+static size_t console_tail = 0;
+
+void mock_hal_console_input(const char *text)
+{
+    while (*text && console_head - console_tail < CONSOLE_IN_SIZE)
+    {
+        console_in[console_head++ % CONSOLE_IN_SIZE] = *text++;
+    }
+
+    // Received USB data ends a __wfi like on the board
+    raise_irq(USBCTRL_IRQ);
+}
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+    if (console_tail != console_head)
+    {
+        return (unsigned char)console_in[console_tail++ % CONSOLE_IN_SIZE];
+    }
+    if (timeout_us)
+    {
+        sleep_us(timeout_us);
+    }
+    return PICO_ERROR_TIMEOUT;
+}
+
+// Collects output until a line is complete
+static char log_line[256];
+static size_t log_len = 0;
+
+int sim_printf(const char *fmt, ...)
+{
+    char text[256];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+
+    for (const char *c = text; *c; c++)
+    {
+        if (*c == '\n' || log_len == sizeof(log_line) - 1)
+        {
+            log_line[log_len] = '\0';
+            host->log(host->ctx, log_line);
+            log_len = 0;
+        }
+        if (*c != '\n')
+        {
+            log_line[log_len++] = *c;
+        }
+    }
+
+    return n;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Interrupts                                                               */
+/* ------------------------------------------------------------------------ */
+
+static irq_handler_t irq_handlers[NUM_IRQS];
+static bool irq_enabled[NUM_IRQS];
+static uint32_t irq_pending = 0;
+static bool irqs_off = false;
+static uint32_t irq_count = 0;
+
+static void deliver_gpio_irqs(void);
+
+static void raise_irq(uint num)
+{
+    if (irqs_off)
+    {
+        irq_pending |= 1u << num;
+        return;
+    }
+    irq_count++;
+    if (num == IO_IRQ_BANK0)
+    {
+        deliver_gpio_irqs();
+    }
+    else if (irq_enabled[num] && irq_handlers[num])
+    {
+        irq_handlers[num]();
+    }
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+    irq_handlers[num] = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+    irq_enabled[num] = enabled;
+}
+
+uint32_t save_and_disable_interrupts()
+{
+    uint32_t status = irqs_off;
+    irqs_off = true;
+    return status;
+}
+
+void restore_interrupts(uint32_t status)
+{
+    irqs_off = status;
+    while (!irqs_off && irq_pending)
+    {
+        uint num = (uint)__builtin_ctz(irq_pending);
+        irq_pending &= ~(1u << num);
+        raise_irq(num);
+    }
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout)
+{
+    uint32_t seen = irq_count;
+
+    while (irq_count == seen && now() < timeout)
+    {
+        host->wait(host->ctx, 0);
+    }
+    return now() >= timeout;
+}
+
+void __wfi()
+{
+    uint32_t seen = irq_count;
+
+    while (irq_count == seen && !irq_pending)
+    {
+        host->wait(host->ctx, 0);
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* GPIO                                                                     */
+/* ------------------------------------------------------------------------ */
+
+static bool gpio_level[NUM_BANK0_GPIOS];
+static bool gpio_output[NUM_BANK0_GPIOS];
+static uint32_t gpio_irq_mask[NUM_BANK0_GPIOS];
+static uint32_t gpio_events[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpio_callback_fn;
+
+static void deliver_gpio_irqs()
+{
+    for (uint pin = 0; pin < NUM_BANK0_GPIOS; pin++)
+    {
+        uint32_t events = gpio_events[pin] & gpio_irq_mask[pin];
+        gpio_events[pin] = 0;
+        if (events && gpio_callback_fn)
+        {
+            gpio_callback_fn(pin, events);
+        }
+    }
+}
+
+void gpio_init(uint gpio)
+{
+    gpio_output[gpio] = false;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+    gpio_output[gpio] = out;
+}
+
+void gpio_pull_up(uint gpio)
+{
+    (void)gpio;
+}
+
+void gpio_pull_down(uint gpio)
+{
+    (void)gpio;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    if (gpio_level[gpio] == value)
+    {
+        return;
+    }
+    gpio_level[gpio] = value;
+    if (gpio_output[gpio])
+    {
+        host->gpio_out(host->ctx, gpio, value);
+    }
+}
+
+bool gpio_get(uint gpio)
+{
+    return gpio_level[gpio];
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled)
+{
+    // Edges seen while disabled do not fire later
+    gpio_events[gpio] &= ~event_mask;
+    if (enabled)
+    {
+        gpio_irq_mask[gpio] |= event_mask;
+    }
+    else
+    {
+        gpio_irq_mask[gpio] &= ~event_mask;
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback)
+{
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+    gpio_callback_fn = callback;
+}
+
+void mock_hal_gpio_in(unsigned pin, bool level)
+{
+    if (pin >= NUM_BANK0_GPIOS || gpio_level[pin] == level)
+    {
+        return;
+    }
+    gpio_level[pin] = level;
+
+    uint32_t event = level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    if (gpio_irq_mask[pin] & event)
+    {
+        gpio_events[pin] |= event;
+        raise_irq(IO_IRQ_BANK0);
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* UART                                                                     */
+/* ------------------------------------------------------------------------ */
+
+struct uart_inst
+{
+    uart_hw_t hw;
+    uint index;
+    uint byte_us;
+    bool rx_irq;
+    bool tx_irq;
+
+    uint8_t rx_fifo[UART_FIFO_DEPTH];
+    uint rx_head;
+    uint rx_count;
+    uint64_t rx_last_us;
+
+    // Byte in the shift register and the time its stop bit is out
+    uint8_t tx_fifo[UART_FIFO_DEPTH];
+    uint tx_head;
+    uint tx_count;
+    bool shifting;
+    uint8_t shift_byte;
+    uint64_t shift_done_us;
+};
+
+uart_inst_t mock_uart0_inst = { .index = 0, .byte_us = 1042 };
+uart_inst_t mock_uart1_inst = { .index = 1, .byte_us = 1042 };
+
+static void uart_update_flags(uart_inst_t *uart)
+{
+    uint32_t fr = 0;
+
+    fr |= uart->rx_count == 0 ? UART_UARTFR_RXFE_BITS : 0;
+    fr |= uart->rx_count == UART_FIFO_DEPTH ? UART_UARTFR_RXFF_BITS : 0;
+    fr |= uart->tx_count == 0 ? UART_UARTFR_TXFE_BITS : 0;
+    fr |= uart->tx_count == UART_FIFO_DEPTH ? UART_UARTFR_TXFF_BITS : 0;
+    fr |= uart->tx_count || uart->shifting ? UART_UARTFR_BUSY_BITS : 0;
+    uart->hw.fr = fr;
+}
+
+static void uart_tick(uart_inst_t *uart)
+{
+    uint64_t t = now();
+
+    while (uart->shifting && t >= uart->shift_done_us)
+    {
+        if (uart->index == 0)
+        {
+            host->uart_tx(host->ctx, uart->shift_byte);
+        }
+
+        if (uart->tx_count)
+        {
+            uart->shift_byte = uart->tx_fifo[uart->tx_head];
+            uart->tx_head = (uart->tx_head + 1) % UART_FIFO_DEPTH;
+            uart->tx_count--;
+            uart->shift_done_us += uart->byte_us;
+        }
+        else
+        {
+            uart->shifting = false;
+        }
+    }
+    uart_update_flags(uart);
+
+    // Both interrupts are level triggered, they keep firing until the FIFO level changes
+    bool rx_due = uart->rx_count >= UART_RX_IRQ_LEVEL ||
+                  (uart->rx_count && t - uart->rx_last_us >= uart->byte_us * 32 / 10);
+    bool tx_due = uart->tx_count <= UART_TX_IRQ_LEVEL;
+
+    if ((uart->rx_irq && rx_due) || (uart->tx_irq && tx_due))
+    {
+        raise_irq(uart->index == 0 ? UART0_IRQ : UART1_IRQ);
+    }
+}
+
+void mock_hal_uart_rx(uint8_t byte)
+{
+    uart_inst_t *uart = uart0;
+
+    if (uart->rx_count == UART_FIFO_DEPTH)
+    {
+        uart->hw.rsr |= UART_UARTRSR_OE_BITS;
+        return;
+    }
+
+    uart->rx_fifo[(uart->rx_head + uart->rx_count) % UART_FIFO_DEPTH] = byte;
+    uart->rx_count++;
+    uart->rx_last_us = now();
+    uart_update_flags(uart);
+}
+
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate)
+{
+    uart->byte_us = (10 * 1000000 + baudrate / 2) / baudrate;
+    if (uart->index == 0)
+    {
+        host->uart_baud(host->ctx, baudrate);
+    }
+    return baudrate;
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate)
+{
+    uart->rx_count = 0;
+    uart->tx_count = 0;
+    uart->shifting = false;
+    uart_update_flags(uart);
+    return uart_set_baudrate(uart, baudrate);
+}
+
+void uart_deinit(uart_inst_t *uart)
+{
+    uart->rx_irq = uart->tx_irq = false;
+}
+
+void uart_set_hw_flow(uart_inst_t *uart, bool cts, bool rts)
+{
+    (void)uart;
+    (void)cts;
+    (void)rts;
+}
+
+void uart_set_format(uart_inst_t *uart, uint data_bits, uint stop_bits, uart_parity_t parity)
+{
+    (void)uart;
+    (void)data_bits;
+    (void)stop_bits;
+    (void)parity;
+}
+
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data)
+{
+    uart->rx_irq = rx_has_data;
+    uart->tx_irq = tx_needs_data;
+}
+
+uint uart_get_index(uart_inst_t *uart)
+{
+    return uart->index;
+}
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart)
+{
+    return &uart->hw;
+}
+
+bool uart_is_writable(uart_inst_t *uart)
+{
+    return uart->tx_count < UART_FIFO_DEPTH;
+}
+
+bool uart_is_readable(uart_inst_t *uart)
+{
+    return uart->rx_count > 0;
+}
+
+void uart_putc_raw(uart_inst_t *uart, char c)
+{
+    while (!uart_is_writable(uart))
+    {
+        sleep_us(uart->byte_us);
+    }
+
+    if (!uart->shifting)
+    {
+        uart->shifting = true;
+        uart->shift_byte = (uint8_t)c;
+        uart->shift_done_us = now() + uart->byte_us;
+    }
+    else
+    {
+        uart->tx_fifo[(uart->tx_head + uart->tx_count) % UART_FIFO_DEPTH] = (uint8_t)c;
+        uart->tx_count++;
+    }
+    uart_update_flags(uart);
+}
+
+char uart_getc(uart_inst_t *uart)
+{
+    while (!uart_is_readable(uart))
+    {
+        tight_loop_contents();
+    }
+
+    uint8_t c = uart->rx_fifo[uart->rx_head];
+    uart->rx_head = (uart->rx_head + 1) % UART_FIFO_DEPTH;
+    uart->rx_count--;
+    uart_update_flags(uart);
+    return (char)c;
+}
+
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        uart_putc_raw(uart, (char)src[i]);
+    }
+}
+
+void uart_read_blocking(uart_inst_t *uart, uint8_t *dst, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        dst[i] = (uint8_t)uart_getc(uart);
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* I2C                                                                      */
+/* ------------------------------------------------------------------------ */
+
+struct i2c_inst
+{
+    i2c_hw_t hw;
+    uint index;
+    uint baud;
+};
+
+i2c_inst_t mock_i2c0_inst = { .index = 0, .baud = 100000 };
+i2c_inst_t mock_i2c1_inst = { .index = 1, .baud = 100000 };
+
+// Start, address and data bytes with their acknowledge bits
+static uint64_t i2c_transfer_us(i2c_inst_t *i2c, size_t bytes)
+{
+    return ((uint64_t)bytes * 9 * 1000000 + i2c->baud - 1) / i2c->baud;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate)
+{
+    i2c->baud = baudrate;
+    i2c->hw.enable = 1;
+    return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t *i2c)
+{
+    i2c->hw.enable = 0;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    (void)nostop;
+    bool ack = host->i2c_write(host->ctx, addr, src, len);
+
+    // A missing device aborts after the address byte
+    sleep_us(i2c_transfer_us(i2c, ack ? len + 1 : 1));
+    return ack ? (int)len : PICO_ERROR_GENERIC;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us)
+{
+    (void)timeout_us;
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+uint i2c_get_index(i2c_inst_t *i2c)
+{
+    return i2c->index;
+}
+
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c)
+{
+    return &i2c->hw;
+}
+
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx)
+{
+    return 32 + i2c->index * 2 + (is_tx ? 0 : 1);
+}
+
+/* ------------------------------------------------------------------------ */
+/* DMA                                                                      */
+/* ------------------------------------------------------------------------ */
+
+#define DMA_CTRL_SIZE_MASK 0x3u
+
+static bool dma_claimed[NUM_DMA_CHANNELS];
+static uint64_t dma_busy_until[NUM_DMA_CHANNELS];
+
+int dma_claim_unused_channel(bool required)
+{
+    for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+    {
+        if (!dma_claimed[ch])
+        {
+            dma_claimed[ch] = true;
+            return (int)ch;
+        }
+    }
+    if (required)
+    {
+        printf("No DMA channels are available\n");
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+    dma_claimed[channel] = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    (void)channel;
+    dma_channel_config c = { DMA_SIZE_32 };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+    c->ctrl = (c->ctrl & ~DMA_CTRL_SIZE_MASK) | (uint32_t)size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+    (void)c;
+    (void)incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+    (void)c;
+    (void)incr;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+    (void)c;
+    (void)dreq;
+}
+
+static uint32_t dma_read_word(const volatile void *src, uint index, enum dma_channel_transfer_size size)
+{
+    switch (size)
+    {
+    case DMA_SIZE_8:
+        return ((const volatile uint8_t *)src)[index];
+    case DMA_SIZE_16:
+        return ((const volatile uint16_t *)src)[index];
+    default:
+        return ((const volatile uint32_t *)src)[index];
+    }
+}
+
+// Plays a data_cmd stream to the bus, a transaction ends at every restart or stop
+static uint64_t i2c_dma_transfer(i2c_inst_t *i2c, const volatile void *src, uint count,
+                                 enum dma_channel_transfer_size size)
+{
+    static uint8_t data[4096];
+    size_t len = 0;
+    size_t bytes = 0;
+
+    // Flags of the previous transfer, the driver reads the clear registers before starting
+    i2c->hw.raw_intr_stat = 0;
+
+    for (uint i = 0; i < count; i++)
+    {
+        uint32_t word = dma_read_word(src, i, size);
+
+        if ((word & I2C_IC_DATA_CMD_RESTART_BITS) && len)
+        {
+            bytes += len + 1;
+            if (!host->i2c_write(host->ctx, (uint8_t)(i2c->hw.tar & 0x7F), data, len))
+            {
+                i2c->hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+                return i2c_transfer_us(i2c, bytes);
+            }
+            len = 0;
+        }
+
+        if (len < sizeof(data))
+        {
+            data[len++] = (uint8_t)word;
+        }
+
+        if (word & I2C_IC_DATA_CMD_STOP_BITS)
+        {
+            bytes += len + 1;
+            if (!host->i2c_write(host->ctx, (uint8_t)(i2c->hw.tar & 0x7F), data, len))
+            {
+                i2c->hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+            }
+            i2c->hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+            len = 0;
+        }
+    }
+
+    return i2c_transfer_us(i2c, bytes);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    if (!trigger)
+    {
+        return;
+    }
+
+    enum dma_channel_transfer_size size = (enum dma_channel_transfer_size)(config->ctrl & DMA_CTRL_SIZE_MASK);
+    i2c_inst_t *targets[] = { i2c0, i2c1 };
+
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++)
+    {
+        if (write_addr == &targets[i]->hw.data_cmd)
+        {
+            dma_busy_until[channel] = now() + i2c_dma_transfer(targets[i], read_addr, transfer_count, size);
+            return;
+        }
+    }
+
+    // Memory to memory, done at once
+    size_t width = 1u << size;
+    memcpy((void *)write_addr, (const void *)read_addr, transfer_count * width);
+    dma_busy_until[channel] = 0;
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+    return now() < dma_busy_until[channel];
+}
+
+void dma_channel_abort(uint channel)
+{
+    dma_busy_until[channel] = 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Random numbers                                                           */
+/* ------------------------------------------------------------------------ */
+
+// SplitMix64 of the time and a call counter, runs stay the same for the same seed
+uint32_t get_rand_32()
+{
+    static uint64_t calls;
+    uint64_t z = now() + ++calls * 0x9E3779B97F4A7C15ull;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Flash                                                                    */
+/* ------------------------------------------------------------------------ */
+
+uint8_t mock_flash[PICO_FLASH_SIZE_BYTES];
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    if (flash_offs % FLASH_SECTOR_SIZE == 0 && count % FLASH_SECTOR_SIZE == 0 &&
+        flash_offs + count <= sizeof(mock_flash))
+    {
+        memset(mock_flash + flash_offs, 0xFF, count);
+    }
+}
+
+// Programming can only clear bits, like on the real chip
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+    if (flash_offs % FLASH_PAGE_SIZE == 0 && count % FLASH_PAGE_SIZE == 0 &&
+        flash_offs + count <= sizeof(mock_flash))
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            mock_flash[flash_offs + i] &= data[i];
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* Simulation hooks                                                         */
+/* ------------------------------------------------------------------------ */
+
+void mock_hal_attach(const sim_host_t *sim_host)
+{
+    host = sim_host;
+}
+
+void mock_hal_tick()
+{
+    uart_tick(uart0);
+    uart_tick(uart1);
+}
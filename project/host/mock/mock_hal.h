@@ -0,0 +1,22 @@
+#ifndef MOCK_HAL_H
+#define MOCK_HAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim_api.h"
+
+// Hooks of the SDK stand-in used by the node glue, see sim_node.c
+
+void mock_hal_attach(const sim_host_t *host);
+
+// Advances the UART and DMA models to host time and delivers pending interrupts
+void mock_hal_tick(void);
+
+void mock_hal_uart_rx(uint8_t byte);
+
+void mock_hal_gpio_in(unsigned pin, bool level);
+
+void mock_hal_console_input(const char *text);
+
+#endif
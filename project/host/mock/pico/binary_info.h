@@ -0,0 +1,7 @@
+#ifndef MOCK_PICO_BINARY_INFO_H
+#define MOCK_PICO_BINARY_INFO_H
+
+#define bi_decl(...)
+#define bi_2pins_with_func(...)
+
+#endif
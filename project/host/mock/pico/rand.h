@@ -0,0 +1,9 @@
+#ifndef MOCK_PICO_RAND_H
+#define MOCK_PICO_RAND_H
+
+#include <stdint.h>
+
+// Derived from the virtual time, a node restarted later draws other numbers, see mock_hal.c
+uint32_t get_rand_32(void);
+
+#endif
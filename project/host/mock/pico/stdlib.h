@@ -0,0 +1,49 @@
+#ifndef MOCK_PICO_STDLIB_H
+#define MOCK_PICO_STDLIB_H
+
+// Stand-in for the parts of the Pico SDK used by the firmware, see mock_hal.c
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pico/types.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+
+#define PICO_ERROR_NONE 0
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_ERROR_GENERIC -2
+
+typedef uint64_t absolute_time_t;
+
+// Simulated nodes have a single core
+static inline uint get_core_num(void)
+{
+    return 0;
+}
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+
+// Waiting hands the virtual time over to the rest of the simulation
+void sleep_ms(uint32_t ms);
+void sleep_us(uint64_t us);
+void busy_wait_us(uint64_t us);
+void tight_loop_contents(void);
+
+absolute_time_t make_timeout_time_us(uint64_t us);
+
+// Returns at the timeout or once an interrupt ran, true if the timeout was reached
+bool best_effort_wfe_or_timeout(absolute_time_t timeout);
+
+bool stdio_init_all(void);
+void stdio_flush(void);
+int getchar_timeout_us(uint32_t timeout_us);
+
+// Output of every node goes through the simulation log, prefixed with the node and the time
+int sim_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+#define printf sim_printf
+
+#endif
@@ -0,0 +1,561 @@
+/**
+*   Behavioural model of the EBYTE E32 module as far as the firmware can see it:
+*   M0/M1 modes, AUX, the SLEEP_MODE commands and the transmission rules of
+*   the README, plus the shared air between the modules.
+*
+*   The air has no geometry, every module hears every other one at the same
+*   level. With a path loss set, every reception draws a fading margin and is
+*   lost below the LoRa sensitivity of its air rate. Packets take the LoRa time on air of their air rate, packets on the
+*   same channel and air rate that overlap are both lost (no capture effect)
+*   and a module cannot receive while it is sending.
+*/
+
+#include <math.h>
+#include <string.h>
+
+#include "e32_model.h"
+
+// Same numbering as e32.h, M0 is bit 0 and M1 bit 1
+#define MODE_NORMAL 0
+#define MODE_WAKEUP 1
+#define MODE_POWERSAVING 2
+#define MODE_SLEEP 3
+
+#define CMD_SAVE_CONFIG 0xC0
+#define CMD_READ_CONFIG 0xC1
+#define CMD_TEMP_CONFIG 0xC2
+#define CMD_READ_VERSION 0xC3
+#define CMD_RESET_MODULE 0xC4
+
+#define OPTION_FIXED 0x80
+#define OPTION_WAKEUP_SHIFT 3
+#define OPTION_WAKEUP_MASK 0x38
+#define OPTION_POWER_MASK 0x03
+
+// Address and channel the module puts in front of the payload on air
+#define AIR_HEADER_BYTES 3
+
+// LoRa packet format used for the time on air: 8 symbol preamble, explicit header, CRC, coding rate 4/5
+#define LORA_PREAMBLE_SYMBOLS 8
+#define LORA_CODING_RATE 1
+
+// Receiver noise figure and thermal noise density, for the sensitivity
+#define NOISE_FIGURE_DB 6.0
+#define THERMAL_NOISE_DBM_HZ -174.0
+
+#define TWO_PI 6.283185307179586
+
+// Transmit power per option bits 1-0 of the E32-433T20
+static const double TX_POWER_DBM[] = { 20, 17, 14, 10 };
+
+// Contents are not checked by the firmware
+static const uint8_t VERSION_REPLY[] = { CMD_READ_VERSION, 0x45, 0x0D, 0x14 };
+
+static const unsigned UART_BAUDS[] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+static const unsigned AIR_BPS[] = { 300, 1200, 2400, 4800, 9600, 19200 };
+
+// Spreading factor and bandwidth per air rate, EBYTE does not publish them so these
+// are the pairs whose LoRa bit rate comes closest to the nominal air rate
+static const struct
+{
+    uint8_t sf;
+    uint32_t bw;
+} LORA_PARAMS[] = {
+    { 12, 125000 }, // 0.3k -> 293 bps
+    { 11, 250000 }, // 1.2k -> 1074 bps
+    { 11, 500000 }, // 2.4k -> 2148 bps
+    { 10, 500000 }, // 4.8k -> 3906 bps
+    { 9, 500000 },  // 9.6k -> 7031 bps
+    { 7, 500000 },  // 19.2k -> 21875 bps
+};
+
+unsigned e32_model_uart_baud(uint8_t speed)
+{
+    return UART_BAUDS[(speed >> 3) & 0x07];
+}
+
+static uint8_t air_rate(uint8_t speed)
+{
+    uint8_t rate = speed & 0x07;
+    return rate > 5 ? 5 : rate;
+}
+
+unsigned e32_model_air_bps(uint8_t speed)
+{
+    return AIR_BPS[air_rate(speed)];
+}
+
+// Demodulator SNR limit of SF7 to SF12 from the SX1276 datasheet, 2.5 dB lower per spreading factor
+double e32_model_sensitivity_dbm(uint8_t speed)
+{
+    const int sf = LORA_PARAMS[air_rate(speed)].sf;
+    const double snr_limit_db = -7.5 - 2.5 * (sf - 7);
+    return THERMAL_NOISE_DBM_HZ + 10 * log10(LORA_PARAMS[air_rate(speed)].bw) + NOISE_FIGURE_DB + snr_limit_db;
+}
+
+// Semtech AN1200.13, low data rate optimisation once a symbol is longer than 16 ms
+uint64_t e32_model_air_time_us(uint8_t speed, size_t len)
+{
+    const int sf = LORA_PARAMS[air_rate(speed)].sf;
+    const double symbol_us = (double)(1u << sf) * 1e6 / LORA_PARAMS[air_rate(speed)].bw;
+    const int de = symbol_us > 16000 ? 1 : 0;
+    const int bits = 8 * (int)(len + AIR_HEADER_BYTES) - 4 * sf + 28 + 16;
+
+    double payload_symbols = ceil((double)bits / (4 * (sf - 2 * de))) * (LORA_CODING_RATE + 4);
+    if (payload_symbols < 0)
+    {
+        payload_symbols = 0;
+    }
+
+    double symbols = LORA_PREAMBLE_SYMBOLS + 4.25 + 8 + payload_symbols;
+    return (uint64_t)ceil(symbols * symbol_us);
+}
+
+// Preamble added in WAKEUP_MODE so modules in POWERSAVING_MODE catch the packet
+static uint64_t wakeup_time_us(const e32_model_t *m)
+{
+    return (uint64_t)(((m->config[5] & OPTION_WAKEUP_MASK) >> OPTION_WAKEUP_SHIFT) + 1) * 250000;
+}
+
+// UART settings the module listens and talks with in its current mode
+static unsigned module_baud(const e32_model_t *m)
+{
+    return m->mode == MODE_SLEEP ? E32_MODEL_SLEEP_BAUD : e32_model_uart_baud(m->config[3]);
+}
+
+static unsigned byte_us(unsigned baud)
+{
+    return (10 * 1000000 + baud / 2) / baud;
+}
+
+// Queues bytes for the MCU, the first one starts lead_us from now if nothing is pending
+static void out_push(e32_model_t *m, const uint8_t *data, size_t len, uint64_t lead_us, uint64_t now)
+{
+    unsigned t = byte_us(module_baud(m));
+
+    if (m->out_len == 0)
+    {
+        m->out_next_us = now + lead_us + t;
+        m->out_end_us = m->out_next_us - t;
+    }
+
+    for (size_t i = 0; i < len && m->out_len < E32_MODEL_OUT_SIZE; i++)
+    {
+        m->out[(m->out_head + m->out_len) % E32_MODEL_OUT_SIZE] = data[i];
+        m->out_len++;
+        m->out_end_us += t;
+    }
+}
+
+void e32_air_init(e32_air_t *air)
+{
+    memset(air, 0, sizeof(*air));
+    air->rng = 1;
+}
+
+// xorshift64*, uniform in (0, 1)
+static double next_uniform(e32_air_t *air)
+{
+    air->rng ^= air->rng >> 12;
+    air->rng ^= air->rng << 25;
+    air->rng ^= air->rng >> 27;
+    return ((air->rng * 0x2545F4914F6CDD1Dull >> 11) + 0.5) / 9007199254740992.0;
+}
+
+// Box-Muller, standard normal
+static double next_normal(e32_air_t *air)
+{
+    double u1 = next_uniform(air);
+    double u2 = next_uniform(air);
+    return sqrt(-2 * log(u1)) * cos(TWO_PI * u2);
+}
+
+// Received power of the packet this time is below what the receiver decodes at its air rate
+static bool fades(e32_air_t *air, const e32_packet_t *pkt, const e32_model_t *m)
+{
+    if (air->path_loss_db <= 0)
+    {
+        return false;
+    }
+
+    double rx_dbm = TX_POWER_DBM[pkt->src->config[5] & OPTION_POWER_MASK] - air->path_loss_db +
+                    air->fading_db * next_normal(air);
+    return rx_dbm < e32_model_sensitivity_dbm(m->config[3]);
+}
+
+void e32_model_init(e32_model_t *m, int id, e32_air_t *air, const e32_model_io_t *io,
+                    const uint8_t factory[E32_MODEL_CONFIG_LEN])
+{
+    memset(m, 0, sizeof(*m));
+    m->id = id;
+    m->io = *io;
+    m->air = air;
+    memcpy(m->config, factory, E32_MODEL_CONFIG_LEN);
+    m->config[0] = CMD_SAVE_CONFIG;
+    memcpy(m->saved, m->config, E32_MODEL_CONFIG_LEN);
+    m->mode = MODE_NORMAL;
+    m->aux = true;
+    m->mcu_baud = e32_model_uart_baud(m->config[3]);
+
+    if (air->n_modules < E32_AIR_MAX_MODULES)
+    {
+        air->modules[air->n_modules++] = m;
+    }
+}
+
+void e32_model_set_pins(e32_model_t *m, bool m0, bool m1, uint64_t now)
+{
+    int mode = (m1 ? 2 : 0) | (m0 ? 1 : 0);
+
+    m->m0 = m0;
+    m->m1 = m1;
+    if (mode == m->mode)
+    {
+        return;
+    }
+
+    if (mode == MODE_SLEEP)
+    {
+        m->cmd_len = 0;
+    }
+    m->mode = mode;
+    m->busy_until = now + E32_MODEL_SWITCH_US;
+}
+
+void e32_model_set_mcu_baud(e32_model_t *m, unsigned baud)
+{
+    m->mcu_baud = baud;
+}
+
+static void reply(e32_model_t *m, const uint8_t *data, size_t len, uint64_t delay_us, uint64_t now)
+{
+    m->busy_until = now + delay_us;
+    out_push(m, data, len, delay_us, now);
+    m->stats.cmds++;
+}
+
+static bool repeated(const e32_model_t *m, uint8_t cmd)
+{
+    return m->cmd_len == 3 && m->cmd[0] == cmd && m->cmd[1] == cmd && m->cmd[2] == cmd;
+}
+
+// Collects a command in SLEEP_MODE and answers it once complete
+static void command_byte(e32_model_t *m, uint8_t byte, uint64_t now)
+{
+    if (m->cmd_len && now - m->cmd_last_us > E32_MODEL_CMD_TIMEOUT_US)
+    {
+        m->cmd_len = 0;
+    }
+    m->cmd_last_us = now;
+
+    if (m->cmd_len == 0 && (byte < CMD_SAVE_CONFIG || byte > CMD_RESET_MODULE))
+    {
+        return;
+    }
+    m->cmd[m->cmd_len++] = byte;
+
+    uint8_t head = m->cmd[0];
+    if (head == CMD_SAVE_CONFIG || head == CMD_TEMP_CONFIG)
+    {
+        if (m->cmd_len < E32_MODEL_CONFIG_LEN)
+        {
+            return;
+        }
+
+        memcpy(m->config, m->cmd, E32_MODEL_CONFIG_LEN);
+        if (head == CMD_SAVE_CONFIG)
+        {
+            memcpy(m->saved, m->cmd, E32_MODEL_CONFIG_LEN);
+        }
+        reply(m, m->cmd, E32_MODEL_CONFIG_LEN, head == CMD_SAVE_CONFIG ? E32_MODEL_SAVE_US : E32_MODEL_REPLY_US, now);
+        m->cmd_len = 0;
+        return;
+    }
+
+    // The other commands are the same byte three times
+    if (byte != head)
+    {
+        m->cmd_len = 0;
+        return;
+    }
+    if (m->cmd_len < 3)
+    {
+        return;
+    }
+
+    if (repeated(m, CMD_READ_CONFIG))
+    {
+        uint8_t data[E32_MODEL_CONFIG_LEN];
+        memcpy(data, m->config, sizeof(data));
+        data[0] = CMD_SAVE_CONFIG;
+        reply(m, data, sizeof(data), E32_MODEL_REPLY_US, now);
+    }
+    else if (repeated(m, CMD_READ_VERSION))
+    {
+        reply(m, VERSION_REPLY, sizeof(VERSION_REPLY), E32_MODEL_REPLY_US, now);
+    }
+    else if (repeated(m, CMD_RESET_MODULE))
+    {
+        memcpy(m->config, m->saved, E32_MODEL_CONFIG_LEN);
+        m->in_len = 0;
+        m->out_len = 0;
+        m->busy_until = now + E32_MODEL_RESET_US;
+        m->stats.cmds++;
+    }
+    m->cmd_len = 0;
+}
+
+void e32_model_uart_in(e32_model_t *m, uint8_t byte, uint64_t now)
+{
+    if (m->mcu_baud != module_baud(m))
+    {
+        m->stats.garbled++;
+        return;
+    }
+
+    switch (m->mode)
+    {
+    case MODE_SLEEP:
+        command_byte(m, byte, now);
+        break;
+
+    case MODE_NORMAL:
+    case MODE_WAKEUP:
+        if (m->in_len == E32_MODEL_BUFFER)
+        {
+            m->stats.overflows++;
+            break;
+        }
+        if (m->in_len == 0)
+        {
+            m->in_first_us = now;
+        }
+        m->in[m->in_len++] = byte;
+        m->in_last_us = now;
+        m->stats.bytes_in++;
+        break;
+
+    default:
+        // POWERSAVING_MODE does not transmit
+        break;
+    }
+}
+
+static void consume(e32_model_t *m, size_t n)
+{
+    memmove(m->in, m->in + n, m->in_len - n);
+    m->in_len -= n;
+    if (m->in_len == 0)
+    {
+        m->have_dest = false;
+    }
+}
+
+// Sends the next packet once the MCU paused for three bytes or a whole packet is buffered
+static void start_packet(e32_model_t *m, uint64_t now)
+{
+    bool fixed = m->config[5] & OPTION_FIXED;
+    size_t header = fixed && !m->have_dest ? 3 : 0;
+    bool pause = now - m->in_last_us >= 3 * byte_us(module_baud(m));
+
+    if (!pause && m->in_len < header + E32_MODEL_PACKET)
+    {
+        return;
+    }
+
+    if (header)
+    {
+        if (m->in_len < header)
+        {
+            // Too short to carry an address, the module drops it
+            consume(m, m->in_len);
+            return;
+        }
+        memcpy(m->dest, m->in, 3);
+        m->have_dest = true;
+        consume(m, 3);
+    }
+    else if (!fixed)
+    {
+        m->dest[0] = m->config[1];
+        m->dest[1] = m->config[2];
+        m->dest[2] = m->config[4];
+    }
+
+    e32_air_t *air = m->air;
+    if (air->n_packets == E32_AIR_MAX_PACKETS || m->in_len == 0)
+    {
+        return;
+    }
+
+    e32_packet_t *pkt = &air->packets[air->n_packets++];
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->src = m;
+    pkt->addh = m->dest[0];
+    pkt->addl = m->dest[1];
+    pkt->chan = m->dest[2];
+    pkt->air_rate = air_rate(m->config[3]);
+    pkt->wakeup = m->mode == MODE_WAKEUP;
+    pkt->len = m->in_len < E32_MODEL_PACKET ? m->in_len : E32_MODEL_PACKET;
+    memcpy(pkt->data, m->in, pkt->len);
+    pkt->queued_us = m->in_first_us;
+    pkt->start_us = now;
+    pkt->end_us = now + e32_model_air_time_us(m->config[3], pkt->len) + (pkt->wakeup ? wakeup_time_us(m) : 0);
+
+    // Rest of the burst keeps the destination and goes in the next packet
+    consume(m, pkt->len);
+    m->in_first_us = now;
+
+    m->transmitting = true;
+    m->tx_start_us = now;
+    m->tx_end_us = pkt->end_us;
+    m->stats.packets_tx++;
+    air->packets_sent++;
+    air->airtime_us += pkt->end_us - pkt->start_us;
+
+    // Every node hears every other one equally well, so any overlap on the same channel
+    // and air rate destroys both packets, other channels and spreading factors do not interfere
+    for (int i = 0; i < air->n_packets - 1; i++)
+    {
+        e32_packet_t *other = &air->packets[i];
+        if (other->chan == pkt->chan && other->air_rate == pkt->air_rate && other->end_us > now)
+        {
+            other->collided = true;
+            pkt->collided = true;
+        }
+    }
+}
+
+void e32_model_step(e32_model_t *m, uint64_t now)
+{
+    if (m->transmitting && now >= m->tx_end_us)
+    {
+        m->transmitting = false;
+    }
+
+    if (!m->transmitting && m->in_len && now >= m->busy_until &&
+        (m->mode == MODE_NORMAL || m->mode == MODE_WAKEUP))
+    {
+        start_packet(m, now);
+    }
+
+    while (m->out_len && now >= m->out_next_us)
+    {
+        uint8_t byte = m->out[m->out_head];
+        m->out_head = (m->out_head + 1) % E32_MODEL_OUT_SIZE;
+        m->out_len--;
+        m->out_next_us += byte_us(module_baud(m));
+
+        if (m->mcu_baud != module_baud(m))
+        {
+            m->stats.garbled++;
+            continue;
+        }
+        m->stats.bytes_out++;
+        m->io.uart_out(m->io.ctx, byte);
+    }
+
+    bool aux = !(now < m->busy_until || m->in_len || m->transmitting || m->out_len);
+    if (aux != m->aux)
+    {
+        m->aux = aux;
+        m->io.aux_out(m->io.ctx, aux);
+    }
+}
+
+// Listening on the channel and air rate of the packet
+static bool tuned(const e32_model_t *m, const e32_packet_t *pkt)
+{
+    if (m == pkt->src)
+    {
+        return false;
+    }
+    if (!(m->mode == MODE_NORMAL || m->mode == MODE_WAKEUP || (m->mode == MODE_POWERSAVING && pkt->wakeup)))
+    {
+        return false;
+    }
+    return m->config[4] == pkt->chan && air_rate(m->config[3]) == pkt->air_rate;
+}
+
+// Destination is the receiver or FFFF, or the receiver listens to all as FFFF
+static bool addressed(const e32_model_t *m, const e32_packet_t *pkt)
+{
+    bool to_all = pkt->addh == 0xFF && pkt->addl == 0xFF;
+    bool hears_all = m->config[1] == 0xFF && m->config[2] == 0xFF;
+    bool to_me = m->config[1] == pkt->addh && m->config[2] == pkt->addl;
+    return to_all || hears_all || to_me;
+}
+
+static void deliver(e32_air_t *air, const e32_packet_t *pkt, uint64_t now)
+{
+    for (int i = 0; i < air->n_modules; i++)
+    {
+        e32_model_t *m = air->modules[i];
+        if (!tuned(m, pkt) || !addressed(m, pkt))
+        {
+            continue;
+        }
+
+        // The radio is half duplex, a module sending during the packet misses it
+        if (m->tx_end_us > pkt->start_us && m->tx_start_us < pkt->end_us)
+        {
+            m->stats.rx_missed++;
+            air->missed++;
+            continue;
+        }
+        if (pkt->collided)
+        {
+            m->stats.rx_collisions++;
+            air->collisions++;
+            continue;
+        }
+        if (fades(air, pkt, m))
+        {
+            m->stats.rx_faded++;
+            air->faded++;
+            continue;
+        }
+
+        out_push(m, pkt->data, pkt->len, E32_MODEL_RX_LEAD_US, now);
+        m->stats.packets_rx++;
+        air->deliveries++;
+
+        if (air->on_deliver)
+        {
+            air->on_deliver(air->cb_ctx, pkt, m, m->out_end_us);
+        }
+    }
+}
+
+void e32_air_step(e32_air_t *air, uint64_t now)
+{
+    int kept = 0;
+
+    for (int i = 0; i < air->n_packets; i++)
+    {
+        if (now >= air->packets[i].end_us)
+        {
+            deliver(air, &air->packets[i], now);
+        }
+        else
+        {
+            air->packets[kept++] = air->packets[i];
+        }
+    }
+    air->n_packets = kept;
+}
+
+void e32_air_reset_stats(e32_air_t *air)
+{
+    air->packets_sent = 0;
+    air->deliveries = 0;
+    air->collisions = 0;
+    air->missed = 0;
+    air->faded = 0;
+    air->airtime_us = 0;
+
+    for (int i = 0; i < air->n_modules; i++)
+    {
+        memset(&air->modules[i]->stats, 0, sizeof(air->modules[i]->stats));
+    }
+}
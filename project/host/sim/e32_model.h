@@ -0,0 +1,188 @@
+#ifndef E32_MODEL_H
+#define E32_MODEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Module transmit buffer and the payload of one packet on air
+#define E32_MODEL_BUFFER 512
+#define E32_MODEL_PACKET 58
+
+// Bytes waiting to go out of the module UART, received packets and replies
+#define E32_MODEL_OUT_SIZE 2048
+
+#define E32_MODEL_CONFIG_LEN 6
+
+// AUX stays low this long after M0/M1 change
+#define E32_MODEL_SWITCH_US 1000
+
+// Processing of a configuration command before the reply starts, SAVE_CONFIG also writes flash
+#define E32_MODEL_REPLY_US 1000
+#define E32_MODEL_SAVE_US 8000
+#define E32_MODEL_RESET_US 100000
+
+// AUX goes low this long before received data is put on the UART
+#define E32_MODEL_RX_LEAD_US 2500
+
+// Partial commands are dropped after this much silence in SLEEP_MODE
+#define E32_MODEL_CMD_TIMEOUT_US 10000
+
+// Serial port used for configuration in SLEEP_MODE regardless of the speed byte
+#define E32_MODEL_SLEEP_BAUD 9600
+
+typedef struct e32_model e32_model_t;
+typedef struct e32_air e32_air_t;
+
+// Connection of a module to its microcontroller
+typedef struct
+{
+    void *ctx;
+    void (*uart_out)(void *ctx, uint8_t byte); // Byte finished arriving at the MCU
+    void (*aux_out)(void *ctx, bool level);
+} e32_model_io_t;
+
+typedef struct
+{
+    uint32_t cmds;       // Configuration commands answered
+    uint32_t bytes_in;   // Bytes accepted for transmission
+    uint32_t overflows;  // Bytes dropped because the transmit buffer was full
+    uint32_t garbled;    // Bytes lost to a baud rate mismatch with the MCU
+    uint32_t packets_tx;
+    uint32_t packets_rx;
+    uint32_t rx_collisions; // Packets for this module lost because they overlapped another one
+    uint32_t rx_missed;     // Packets for this module sent while it was sending itself
+    uint32_t rx_faded;      // Packets for this module that arrived below its sensitivity
+    uint32_t bytes_out;     // Bytes put on the UART towards the MCU
+} e32_model_stats_t;
+
+typedef struct
+{
+    e32_model_t *src;
+    uint8_t addh;
+    uint8_t addl;
+    uint8_t chan;
+    uint8_t air_rate;   // Bits 2-0 of the speed byte, 5-7 folded into 5
+    bool wakeup;        // Sent in WAKEUP_MODE, heard by modules in POWERSAVING_MODE
+    uint8_t data[E32_MODEL_PACKET];
+    size_t len;
+    uint64_t queued_us; // First byte of the packet reached the sending module
+    uint64_t start_us;
+    uint64_t end_us;
+    bool collided;      // Overlapped another packet on the same channel and air rate
+} e32_packet_t;
+
+struct e32_model
+{
+    int id;
+    e32_model_io_t io;
+    e32_air_t *air;
+
+    uint8_t config[E32_MODEL_CONFIG_LEN]; // { header, ADDH, ADDL, SPED, CHAN, OPTION }
+    uint8_t saved[E32_MODEL_CONFIG_LEN];  // Restored by RESET_MODULE
+    bool m0;
+    bool m1;
+    int mode;
+    bool aux;
+    uint64_t busy_until;
+    unsigned mcu_baud;
+
+    // Command being received in SLEEP_MODE
+    uint8_t cmd[E32_MODEL_CONFIG_LEN];
+    size_t cmd_len;
+    uint64_t cmd_last_us;
+
+    // Data waiting to be sent, in fixed mode the first three bytes of a burst are the destination
+    uint8_t in[E32_MODEL_BUFFER];
+    size_t in_len;
+    uint64_t in_first_us;
+    uint64_t in_last_us;
+    bool have_dest;
+    uint8_t dest[3];
+
+    bool transmitting;
+    uint64_t tx_start_us;
+    uint64_t tx_end_us;
+
+    uint8_t out[E32_MODEL_OUT_SIZE];
+    size_t out_head;
+    size_t out_len;
+    uint64_t out_next_us; // Time the next byte finishes arriving at the MCU
+    uint64_t out_end_us;  // Time the last queued byte does
+
+    e32_model_stats_t stats;
+};
+
+/**
+*   @brief Called for every packet a module hands to its MCU
+*   @param pkt Packet as sent
+*   @param dst Receiving module
+*   @param done_us Time its last byte reaches the MCU
+*/
+typedef void (*e32_air_deliver_cb_t)(void *ctx, const e32_packet_t *pkt, const e32_model_t *dst, uint64_t done_us);
+
+#define E32_AIR_MAX_MODULES 64
+#define E32_AIR_MAX_PACKETS 64
+
+// Radio channel shared by all modules of a simulation
+struct e32_air
+{
+    e32_model_t *modules[E32_AIR_MAX_MODULES];
+    int n_modules;
+    e32_packet_t packets[E32_AIR_MAX_PACKETS];
+    int n_packets;
+
+    e32_air_deliver_cb_t on_deliver;
+    void *cb_ctx;
+
+    uint32_t packets_sent;
+    uint32_t deliveries;
+    uint32_t collisions; // Receptions lost to overlapping packets
+    uint32_t missed;     // Receptions lost because the receiver was sending
+    uint32_t faded;      // Receptions lost below the sensitivity of the air rate
+
+    // Link budget, every packet is heard while path_loss_db is 0
+    double path_loss_db; // Between every pair of modules
+    double fading_db;    // Standard deviation of the fading drawn per reception
+    uint64_t rng;        // State of the fading draws, any value but 0
+    uint64_t airtime_us; // Sum of the time on air of all packets sent
+};
+
+void e32_air_init(e32_air_t *air);
+
+// Hands packets whose air time is over to every module that hears them and was not sending
+void e32_air_step(e32_air_t *air, uint64_t now);
+
+// Lowest received power in dBm a module decodes at the air rate of a speed byte
+double e32_model_sensitivity_dbm(uint8_t speed);
+
+// Sets the counters of the air and of every module back to zero
+void e32_air_reset_stats(e32_air_t *air);
+
+/**
+*   @brief Puts a module on the air with its factory configuration, AUX high and NORMAL_MODE
+*   @param factory Configuration after power up, header byte ignored
+*/
+void e32_model_init(e32_model_t *m, int id, e32_air_t *air, const e32_model_io_t *io,
+                    const uint8_t factory[E32_MODEL_CONFIG_LEN]);
+
+// M0/M1 levels driven by the MCU
+void e32_model_set_pins(e32_model_t *m, bool m0, bool m1, uint64_t now);
+
+// Baud rate of the MCU UART, bytes only get through if the module runs at the same rate
+void e32_model_set_mcu_baud(e32_model_t *m, unsigned baud);
+
+// Byte from the MCU finished arriving on the RXD pin of the module
+void e32_model_uart_in(e32_model_t *m, uint8_t byte, uint64_t now);
+
+// Starts packets, writes UART output and updates AUX up to now
+void e32_model_step(e32_model_t *m, uint64_t now);
+
+// UART baud and nominal air data rate selected by a speed byte
+unsigned e32_model_uart_baud(uint8_t speed);
+unsigned e32_model_air_bps(uint8_t speed);
+
+// LoRa time on air of a packet with len payload bytes sent with the given speed byte
+uint64_t e32_model_air_time_us(uint8_t speed, size_t len);
+
+#endif
@@ -0,0 +1,834 @@
+/**
+*   Runs the firmware of several nodes against modeled E32 modules and reports
+*   what got through.
+*
+*   Node i is configured like NODE<i+1>_CONFIG of lora_driver.c (address 000i,
+*   9600 baud, fixed transmission), nodes after the fifth share channel 06
+*   unless -c puts every node on one channel. After the warm up every node
+*   presses a random one of its enabled buttons at the given rate, so traffic
+*   follows the destinations wired to the buttons.
+*
+*   -S sweeps node counts and rates with every node on one channel and reports
+*   the delivery ratio of each point, by default with broadcast traffic only,
+*   to size how many nodes and how much traffic a channel can take.
+*
+*   -B runs the bench command of the firmware on node 1 against node 2 at each
+*   air rate of -A and reports the round trip, loss and goodput it measured.
+*
+*   -X lets node 1 send fixed messages to node 2, resets node 1 halfway and
+*   fails unless node 2 shows every message, the sequence numbers start over
+*   after the reset and must not be taken for repeats.
+*
+*   -T writes the event trace of every node at the end of the run, turn it into
+*   a Chrome/Perfetto trace with trace2json.
+*/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#ifndef LORA_NODE_MODULE
+#define LORA_NODE_MODULE "lora_node.so"
+#endif
+
+#define MAX_SWEEP_POINTS 16
+
+// Long enough for a few dozen messages per point at the lowest default rate
+#define SWEEP_SECONDS 30
+
+// Channel the broadcast button sends on
+#define BROADCAST_CHANNEL 0x04
+
+// Node 1 sends the probes of -B to the destination of this button, 0002 on channel 04
+#define BENCH_PEER 1
+
+// Longest wait for one probe and its echo, the firmware gives up on an echo after 10 s
+#define BENCH_PROBE_LIMIT_US 12000000ull
+
+// Node 1 sends the messages of -X with this button, to 0002 on channel 04
+#define RESTART_BUTTON SIM_PIN_SEND_MODULE_1_BTN
+
+// Longest wait for node 1 to get its messages acknowledged with -X
+#define RESTART_IDLE_LIMIT_US 60000000ull
+
+// Spread of the per reception fading with -L, typical of a moving or obstructed link
+#define FADING_DB 4.0
+
+// Presses of a burst (-b) are this far apart, just over the firmware's 50 ms debounce
+#define BURST_GAP_US 60000
+
+// Speed byte of the node configurations without the air rate, 9600 8N1
+#define NODE_SPEED 0x18
+
+static const uint8_t NODE_CHANNELS[] = { 0x02, 0x04, 0x06, 0x06, 0x06 };
+
+static const unsigned BUTTONS[] = { SIM_PIN_BROADCAST_BTN, SIM_PIN_SEND_MODULE_1_BTN, SIM_PIN_SEND_MODULE_2_BTN };
+
+#define TRAFFIC_BROADCAST 0x1
+#define TRAFFIC_FIXED 0x6
+#define TRAFFIC_ALL 0x7
+
+typedef struct
+{
+    int n_nodes;
+    double seconds;
+    double rate;   // Button presses per second and node
+    int burst;     // Presses in a row each time, on the same button
+    double warmup;
+    uint64_t seed;
+    int channel;   // -1 = channel of NODE<i>_CONFIG
+    uint8_t air_rate;
+    unsigned buttons; // Mask of BUTTONS that get pressed
+    const char *module;
+    double path_loss_db; // 0 = every packet is heard
+    bool link;           // Link controller switched on after the warm up
+    bool verbose;
+} scenario_t;
+
+typedef struct
+{
+    uint64_t *samples;
+    size_t count;
+    size_t cap;
+} latency_t;
+
+typedef struct
+{
+    uint32_t presses;
+    latency_t lat;
+} result_t;
+
+static void on_log(void *ctx, int node, uint64_t now_us, const char *line)
+{
+    (void)ctx;
+    printf("%10.3f ms  node %d: %s\n", now_us / 1000.0, node + 1, line);
+}
+
+// Trace dumps keep the node so trace2json can tell them apart
+static void on_trace_log(void *ctx, int node, uint64_t now_us, const char *line)
+{
+    (void)now_us;
+    fprintf(ctx, "node %d: %s\n", node + 1, line);
+}
+
+static bool write_trace(sim_t *sim, const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+
+    sim->on_log = on_trace_log;
+    sim->log_ctx = f;
+    for (int i = 0; i < sim->n_nodes; i++)
+    {
+        sim->nodes[i].api->trace_dump();
+    }
+    sim->on_log = NULL;
+    sim->log_ctx = NULL;
+
+    return fclose(f) == 0;
+}
+
+static void on_deliver(void *ctx, const e32_packet_t *pkt, const e32_model_t *dst, uint64_t done_us)
+{
+    latency_t *lat = ctx;
+    (void)dst;
+
+    if (lat->count == lat->cap)
+    {
+        size_t cap = lat->cap ? lat->cap * 2 : 1024;
+        uint64_t *samples = realloc(lat->samples, cap * sizeof(uint64_t));
+        if (!samples)
+        {
+            return;
+        }
+        lat->samples = samples;
+        lat->cap = cap;
+    }
+    lat->samples[lat->count++] = done_us - pkt->queued_us;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts the samples on first use
+static double percentile_ms(latency_t *lat, double p)
+{
+    if (lat->count == 0)
+    {
+        return 0;
+    }
+    qsort(lat->samples, lat->count, sizeof(uint64_t), compare_u64);
+    size_t i = (size_t)(p * (lat->count - 1) + 0.5);
+    return lat->samples[i] / 1000.0;
+}
+
+// Deterministic for a given seed
+static uint32_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (uint32_t)(*state >> 32);
+}
+
+static unsigned pick_button(uint64_t *state, unsigned mask)
+{
+    unsigned choices[3];
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        if (mask & (1u << i))
+        {
+            choices[n++] = BUTTONS[i];
+        }
+    }
+    return choices[next_random(state) % n];
+}
+
+// Receptions that made it, out of all the modules a packet was meant for
+static double delivery_ratio(const e32_air_t *air)
+{
+    uint32_t meant = air->deliveries + air->collisions + air->missed + air->faded;
+    return meant ? (double)air->deliveries / meant : 1.0;
+}
+
+/**
+*   @brief Sets up the nodes of a scenario and runs it to the end
+*   @param sim Simulation to run it in, freed by the caller
+*   @return false if the nodes could not be loaded
+*
+*   Counters and latency cover the time after the warm up only.
+*/
+static bool run_scenario(const scenario_t *sc, sim_t *sim, result_t *res)
+{
+    memset(sim, 0, sizeof(*sim));
+    memset(res, 0, sizeof(*res));
+
+    uint8_t (*configs)[SIM_CONFIG_LEN] = calloc((size_t)sc->n_nodes, SIM_CONFIG_LEN);
+    if (!configs)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < sc->n_nodes; i++)
+    {
+        uint8_t chan = i < (int)sizeof(NODE_CHANNELS) ? NODE_CHANNELS[i] : 0x06;
+        const uint8_t config[SIM_CONFIG_LEN] = {
+            0xC0, (uint8_t)((i + 1) >> 8), (uint8_t)(i + 1), (uint8_t)(NODE_SPEED | sc->air_rate),
+            sc->channel >= 0 ? (uint8_t)sc->channel : chan, 0xC4,
+        };
+        memcpy(configs[i], config, SIM_CONFIG_LEN);
+    }
+
+    bool ok = sim_init(sim, sc->module, sc->n_nodes, (const uint8_t (*)[SIM_CONFIG_LEN])configs);
+    free(configs);
+    if (!ok)
+    {
+        return false;
+    }
+
+    sim->on_log = sc->verbose ? on_log : NULL;
+    sim->air.on_deliver = on_deliver;
+    sim->air.cb_ctx = &res->lat;
+    sim->air.path_loss_db = sc->path_loss_db;
+    sim->air.fading_db = FADING_DB;
+    sim->air.rng = sc->seed * 0x9E3779B97F4A7C15ull + 1;
+
+    uint64_t warmup_us = (uint64_t)(sc->warmup * 1e6);
+    uint64_t end_us = warmup_us + (uint64_t)(sc->seconds * 1e6);
+    uint64_t period_us = sc->rate > 0 ? (uint64_t)(1e6 / sc->rate) : 0;
+    uint64_t state = sc->seed * 0x9E3779B97F4A7C15ull + 1;
+    uint64_t *next_press = calloc((size_t)sc->n_nodes, sizeof(uint64_t));
+    unsigned *burst_button = calloc((size_t)sc->n_nodes, sizeof(unsigned));
+    int *burst_left = calloc((size_t)sc->n_nodes, sizeof(int));
+    if (!next_press || !burst_button || !burst_left)
+    {
+        free(next_press);
+        free(burst_button);
+        free(burst_left);
+        return false;
+    }
+
+    sim_run_until(sim, warmup_us);
+
+    // Start up configuration is not part of the figures
+    res->lat.count = 0;
+    e32_air_reset_stats(&sim->air);
+
+    for (int i = 0; sc->link && i < sc->n_nodes; i++)
+    {
+        sim->nodes[i].api->console("link on\n");
+    }
+
+    for (int i = 0; i < sc->n_nodes; i++)
+    {
+        next_press[i] = warmup_us + (period_us ? next_random(&state) % period_us : 0);
+    }
+
+    while (sim->now_us < end_us)
+    {
+        uint64_t until = end_us;
+        for (int i = 0; period_us && sc->buttons && i < sc->n_nodes; i++)
+        {
+            if (next_press[i] <= sim->now_us)
+            {
+                if (burst_left[i] == 0)
+                {
+                    burst_button[i] = pick_button(&state, sc->buttons);
+                    burst_left[i] = sc->burst > 1 ? sc->burst : 1;
+                }
+                sim_press(sim, i, burst_button[i]);
+                res->presses++;
+
+                // Rest of the burst, then uniform between half and one and a half periods
+                if (--burst_left[i] > 0)
+                {
+                    next_press[i] = sim->now_us + BURST_GAP_US;
+                }
+                else
+                {
+                    next_press[i] = sim->now_us + period_us / 2 + next_random(&state) % (period_us + 1);
+                }
+            }
+            if (next_press[i] < until)
+            {
+                until = next_press[i];
+            }
+        }
+        sim_run_until(sim, until > sim->now_us ? until : sim->now_us + SIM_STEP_US);
+    }
+
+    free(next_press);
+    free(burst_button);
+    free(burst_left);
+    return true;
+}
+
+static void report(sim_t *sim, result_t *res, double seconds)
+{
+    printf("\n%-5s %-4s %-3s %6s %6s %6s %6s %6s %6s %6s %6s %5s %6s %6s %6s %6s %6s %6s %5s %5s %6s %6s %7s %5s %3s\n",
+           "node", "addr", "ch", "queued", "sent", "drop", "rel", "acked", "lost", "retry", "rx_ok", "crc", "air_tx",
+           "air_rx", "collid", "missed", "faded", "frames", "ui_q", "ui_dr", "awake%", "wor%", "ms/msg", "bps", "sw");
+
+    uint64_t bytes = 0;
+    uint32_t messages = 0;
+    uint32_t frames = 0;
+    uint32_t max_records = 0;
+    uint32_t dropped = 0;
+    uint32_t shown = 0;
+    for (int i = 0; i < sim->n_nodes; i++)
+    {
+        sim_node_t *node = &sim->nodes[i];
+        sim_node_stats_t s;
+        node->api->get_stats(&s);
+        bytes += node->e32.stats.bytes_out;
+        messages += s.batch_messages;
+        frames += s.batch_frames;
+        max_records = s.batch_max_records > max_records ? s.batch_max_records : max_records;
+        dropped += s.batch_dropped;
+        shown += s.ui_queued;
+
+        // Core running and module in WOR since the node started, awake time per message of the bursts that had any
+        double total_us = (double)(s.power_awake_us + s.power_asleep_us);
+        double awake = total_us > 0 ? 100.0 * s.power_awake_us / total_us : 0.0;
+        double wor = total_us > 0 ? 100.0 * s.power_parked_us / total_us : 0.0;
+        double per_msg = s.power_messages ? s.power_msg_awake_us / 1000.0 / s.power_messages : 0.0;
+
+        // Air rate the module ends with and the switches the link controller made to get there
+        printf("%-5d %02X%02X %02X  %6u %6u %6u %6u %6u %6u %6u %6u %5u %6u %6u %6u %6u %6u %6u %5u %5u %6.2f %6.1f %7.1f %5u %3u\n",
+               i + 1, node->config[1], node->config[2], node->config[4], s.tx_queued, s.tx_sent, s.tx_dropped,
+               s.rel_sent, s.rel_delivered, s.rel_lost, s.rel_retries, s.frames_ok, s.crc_errors,
+               node->e32.stats.packets_tx, node->e32.stats.packets_rx, node->e32.stats.rx_collisions,
+               node->e32.stats.rx_missed, node->e32.stats.rx_faded, node->oled.stats.frames, s.ui_max_depth,
+               s.ui_dropped, awake, wor, per_msg, e32_model_air_bps(node->e32.config[3]), s.link_switches);
+    }
+
+    const e32_air_t *air = &sim->air;
+    printf("\n%u presses, air: %u packets sent, %u received, %u lost to collisions, %u missed while sending, "
+           "%u below sensitivity\n",
+           res->presses, air->packets_sent, air->deliveries, air->collisions, air->missed, air->faded);
+    printf("delivery ratio %.1f %%, channel load %.2f\n", 100 * delivery_ratio(air),
+           seconds > 0 ? air->airtime_us / (seconds * 1e6) : 0.0);
+    printf("packet latency (module input to receiver UART): p50 %.1f ms  p99 %.1f ms  max %.1f ms\n",
+           percentile_ms(&res->lat, 0.50), percentile_ms(&res->lat, 0.99), percentile_ms(&res->lat, 1.0));
+    printf("received %.1f bytes/s over %.1f s\n", seconds > 0 ? bytes / seconds : 0.0, seconds);
+    printf("%u messages sent in %u frames (up to %u per frame), %u dropped, %u shown, %.2f messages/s\n", messages,
+           frames, max_records, dropped, shown, seconds > 0 ? shown / seconds : 0.0);
+}
+
+static int parse_list(const char *text, double *values, int max)
+{
+    int n = 0;
+    char *end;
+
+    while (n < max && *text)
+    {
+        values[n++] = strtod(text, &end);
+        if (end == text)
+        {
+            return 0;
+        }
+        text = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+/**
+*   Runs every combination of node count and rate and prints, for each rate,
+*   the largest node count whose delivery ratio stays at or above min_ratio,
+*   and for each node count the highest rate that does.
+*/
+static int sweep(const scenario_t *base, const double *counts, int n_counts, const double *rates, int n_rates,
+                 double min_ratio)
+{
+    double ratios[MAX_SWEEP_POINTS][MAX_SWEEP_POINTS];
+
+    printf("%5s %7s %9s %8s %9s %9s %9s %8s\n", "nodes", "rate", "offered", "load", "delivery", "collided",
+           "missed", "p99 ms");
+
+    for (int c = 0; c < n_counts; c++)
+    {
+        for (int r = 0; r < n_rates; r++)
+        {
+            scenario_t sc = *base;
+            sc.n_nodes = (int)counts[c];
+            sc.rate = rates[r];
+
+            sim_t sim;
+            result_t res;
+            if (!run_scenario(&sc, &sim, &res))
+            {
+                sim_free(&sim);
+                free(res.lat.samples);
+                return 1;
+            }
+
+            const e32_air_t *air = &sim.air;
+            uint32_t meant = air->deliveries + air->collisions + air->missed + air->faded;
+            ratios[c][r] = delivery_ratio(air);
+
+            printf("%5d %7.3f %9.2f %8.2f %8.1f%% %8.1f%% %8.1f%% %8.1f\n", sc.n_nodes, sc.rate,
+                   res.presses / sc.seconds, air->airtime_us / (sc.seconds * 1e6), 100 * ratios[c][r],
+                   meant ? 100.0 * air->collisions / meant : 0.0, meant ? 100.0 * air->missed / meant : 0.0,
+                   percentile_ms(&res.lat, 0.99));
+            fflush(stdout);
+
+            sim_free(&sim);
+            free(res.lat.samples);
+        }
+    }
+
+    printf("\nlargest node count with delivery >= %.0f %%:\n", 100 * min_ratio);
+    for (int r = 0; r < n_rates; r++)
+    {
+        int best = 0;
+        for (int c = 0; c < n_counts; c++)
+        {
+            if (ratios[c][r] >= min_ratio && (int)counts[c] > best)
+            {
+                best = (int)counts[c];
+            }
+        }
+        printf("  %7.3f presses/s per node: %s%d\n", rates[r], best ? "" : "< ", best ? best : (int)counts[0]);
+    }
+
+    printf("highest rate per node with delivery >= %.0f %%:\n", 100 * min_ratio);
+    for (int c = 0; c < n_counts; c++)
+    {
+        double best = 0;
+        for (int r = 0; r < n_rates; r++)
+        {
+            if (ratios[c][r] >= min_ratio && rates[r] > best)
+            {
+                best = rates[r];
+            }
+        }
+        printf("  %3d nodes: %s%.3f presses/s\n", (int)counts[c], best > 0 ? "" : "< ", best > 0 ? best : rates[0]);
+    }
+    return 0;
+}
+
+/**
+*   Lets node 1 probe node 2 with the firmware bench command at every air rate,
+*   both nodes on the broadcast channel, and prints the results the firmware
+*   kept next to the one way packet latency of the air model.
+*/
+static int bench(const scenario_t *base, const double *air_rates, int n_rates, unsigned probes, unsigned interval_ms,
+                 unsigned size)
+{
+    char command[64];
+    snprintf(command, sizeof(command), "bench %d %u %u %u\n", BENCH_PEER, probes, interval_ms, size);
+
+    printf("%9s %6s %6s %7s %8s %8s %8s %9s %8s %9s\n", "air bps", "sent", "echoed", "loss", "rtt p50", "rtt p99",
+           "rtt max", "goodput", "fwd loss", "air p50");
+
+    for (int r = 0; r < n_rates; r++)
+    {
+        scenario_t sc = *base;
+        sc.n_nodes = 2;
+        sc.channel = BROADCAST_CHANNEL;
+        sc.air_rate = (uint8_t)((int)air_rates[r] & 0x07);
+        sc.rate = 0;
+        sc.seconds = 0;
+
+        sim_t sim;
+        result_t res;
+        if (!run_scenario(&sc, &sim, &res))
+        {
+            sim_free(&sim);
+            free(res.lat.samples);
+            return 1;
+        }
+
+        sim.nodes[0].api->console(command);
+
+        uint64_t limit_us = sim.now_us + probes * (interval_ms * 1000ull + BENCH_PROBE_LIMIT_US);
+        sim_node_stats_t tx;
+        sim_node_stats_t rx;
+        do
+        {
+            sim_run_until(&sim, sim.now_us + 100000);
+            sim.nodes[0].api->get_stats(&tx);
+        } while ((tx.bench_running || !tx.bench_sent) && sim.now_us < limit_us);
+        sim.nodes[1].api->get_stats(&rx);
+
+        uint32_t fwd_meant = rx.bench_rx_probes + rx.bench_rx_missing;
+        printf("%9u %6u %6u %6.1f%% %6.1fms %6.1fms %6.1fms %7.1fB/s %7.1f%% %7.1fms%s\n",
+               e32_model_air_bps((uint8_t)(NODE_SPEED | sc.air_rate)), tx.bench_sent, tx.bench_echoes,
+               tx.bench_sent ? 100.0 * (tx.bench_sent - tx.bench_echoes) / tx.bench_sent : 0.0,
+               tx.bench_rtt_p50_us / 1000.0, tx.bench_rtt_p99_us / 1000.0, tx.bench_rtt_max_us / 1000.0,
+               tx.bench_elapsed_us ? tx.bench_echo_bytes * 1e6 / tx.bench_elapsed_us : 0.0,
+               fwd_meant ? 100.0 * rx.bench_rx_missing / fwd_meant : 0.0, percentile_ms(&res.lat, 0.50),
+               tx.bench_running ? "  (unfinished)" : "");
+        fflush(stdout);
+
+        sim_free(&sim);
+        free(res.lat.samples);
+    }
+    return 0;
+}
+
+// Runs until every message node 1 took since its start is acknowledged or given up
+static bool wait_idle(sim_t *sim, uint32_t messages)
+{
+    uint64_t limit_us = sim->now_us + RESTART_IDLE_LIMIT_US;
+    sim_node_stats_t s;
+
+    do
+    {
+        sim_run_until(sim, sim->now_us + 100000);
+        sim->nodes[0].api->get_stats(&s);
+    } while ((s.batch_messages < messages || s.rel_sent < s.batch_frames ||
+              s.rel_delivered + s.rel_lost < s.rel_sent) && sim->now_us < limit_us);
+
+    return sim->now_us < limit_us;
+}
+
+/**
+*   Node 1 sends count messages to node 2, one per -r period, and is reset
+*   once half of them are acknowledged. Returns 0 if node 2 showed every one.
+*/
+static int restart_check(const scenario_t *base, unsigned count)
+{
+    scenario_t sc = *base;
+    sc.n_nodes = 2;
+    sc.rate = 0;
+    sc.seconds = 0;
+
+    sim_t sim;
+    result_t res;
+    if (!run_scenario(&sc, &sim, &res))
+    {
+        sim_free(&sim);
+        free(res.lat.samples);
+        return 1;
+    }
+
+    uint64_t period_us = base->rate > 0 ? (uint64_t)(1e6 / base->rate) : 1000000;
+    uint64_t warmup_us = (uint64_t)(base->warmup * 1e6);
+    uint32_t since_boot = 0;
+    uint32_t lost = 0;
+    bool ok = true;
+
+    for (unsigned i = 0; i < count && ok; i++)
+    {
+        if (i == count / 2)
+        {
+            sim_node_stats_t s;
+            ok = wait_idle(&sim, since_boot);
+            sim.nodes[0].api->get_stats(&s);
+            lost += s.rel_lost;
+            ok = ok && sim_restart(&sim, 0);
+            sim_run_until(&sim, sim.now_us + warmup_us);
+            since_boot = 0;
+        }
+
+        sim_press(&sim, 0, RESTART_BUTTON);
+        since_boot++;
+        sim_run_until(&sim, sim.now_us + period_us);
+    }
+
+    sim_node_stats_t tx;
+    sim_node_stats_t rx;
+    ok = ok && wait_idle(&sim, since_boot);
+    sim.nodes[0].api->get_stats(&tx);
+    sim.nodes[1].api->get_stats(&rx);
+    lost += tx.rel_lost;
+
+    printf("%u messages, node 1 reset after %u, %u lost by node 1, %u shown by node 2, %u repeats dropped\n", count,
+           count / 2, lost, rx.ui_queued, rx.rel_duplicates);
+    ok = ok && lost == 0 && rx.ui_queued == count;
+    printf("%s\n", ok ? "ok" : "FAILED");
+
+    sim_free(&sim);
+    free(res.lat.samples);
+    return ok ? 0 : 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -n nodes       number of nodes (2)\n"
+            "  -t seconds     simulated time after the warm up (10, 30 with -S)\n"
+            "  -r rate        button presses per second and node (0.5)\n"
+            "  -b count       presses in a row on one button, 60 ms apart, -r counts the bursts (1)\n"
+            "  -w seconds     warm up before the traffic starts (1)\n"
+            "  -s seed        seed of the traffic pattern (1)\n"
+            "  -c channel     put every node on this channel\n"
+            "  -a rate        air rate bits of the speed byte, 0-5 (2 = 2.4k)\n"
+            "  -p traffic     broadcast, fixed or all (all, broadcast with -S)\n"
+            "  -S             sweep node counts and rates on one channel\n"
+            "  -N list        node counts of the sweep (2,4,8,16,32)\n"
+            "  -R list        rates of the sweep (0.05,0.1,0.2,0.5,1)\n"
+            "  -q ratio       delivery ratio a sweep point must reach (0.9)\n"
+            "  -m module      node module to load\n"
+            "  -d             print every display at the end\n"
+            "  -T file        write the event trace of every node to file\n"
+            "  -L dB          path loss between the nodes, receptions fade below sensitivity (0 = off)\n"
+            "  -l             switch the link controller of every node on after the warm up\n"
+            "  -B             benchmark node 1 to node 2 with the bench command\n"
+            "  -A list        air rates of the benchmark (0,1,2,3,4,5)\n"
+            "  -k probes      probes per air rate (50)\n"
+            "  -i ms          time between probes, 0 = next after the echo (0)\n"
+            "  -z bytes       probe payload size (32)\n"
+            "  -X count       node 1 sends count messages to node 2 and is reset halfway, fails on loss\n"
+            "  -v             print what the nodes log\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    scenario_t sc = {
+        .n_nodes = 2,
+        .seconds = 10,
+        .rate = 0.5,
+        .burst = 1,
+        .warmup = 1,
+        .seed = 1,
+        .channel = -1,
+        .air_rate = 2,
+        .buttons = 0,
+        .module = LORA_NODE_MODULE,
+        .verbose = false,
+    };
+    bool dump = false;
+    const char *trace_path = NULL;
+    bool do_bench = false;
+    double air_rates[MAX_SWEEP_POINTS] = { 0, 1, 2, 3, 4, 5 };
+    int n_air_rates = 6;
+    unsigned probes = 50;
+    unsigned interval_ms = 0;
+    unsigned probe_size = 32;
+    bool do_sweep = false;
+    double counts[MAX_SWEEP_POINTS] = { 2, 4, 8, 16, 32 };
+    double rates[MAX_SWEEP_POINTS] = { 0.05, 0.1, 0.2, 0.5, 1 };
+    int n_counts = 5;
+    int n_rates = 5;
+    double min_ratio = 0.9;
+    bool seconds_set = false;
+    unsigned restart_count = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:r:b:w:s:c:a:p:SN:R:q:m:dT:L:lBA:k:i:z:X:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            sc.n_nodes = atoi(optarg);
+            break;
+        case 't':
+            sc.seconds = atof(optarg);
+            seconds_set = true;
+            break;
+        case 'r':
+            sc.rate = atof(optarg);
+            break;
+        case 'b':
+            sc.burst = atoi(optarg);
+            break;
+        case 'w':
+            sc.warmup = atof(optarg);
+            break;
+        case 's':
+            sc.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'c':
+            sc.channel = (int)strtol(optarg, NULL, 0) & 0xFF;
+            break;
+        case 'a':
+            sc.air_rate = (uint8_t)(atoi(optarg) & 0x07);
+            break;
+        case 'p':
+            sc.buttons = !strcmp(optarg, "broadcast") ? TRAFFIC_BROADCAST
+                         : !strcmp(optarg, "fixed")   ? TRAFFIC_FIXED
+                         : !strcmp(optarg, "all")     ? TRAFFIC_ALL
+                                                      : 0;
+            if (!sc.buttons)
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'S':
+            do_sweep = true;
+            break;
+        case 'N':
+            n_counts = parse_list(optarg, counts, MAX_SWEEP_POINTS);
+            break;
+        case 'R':
+            n_rates = parse_list(optarg, rates, MAX_SWEEP_POINTS);
+            break;
+        case 'q':
+            min_ratio = atof(optarg);
+            break;
+        case 'm':
+            sc.module = optarg;
+            break;
+        case 'd':
+            dump = true;
+            break;
+        case 'T':
+            trace_path = optarg;
+            break;
+        case 'L':
+            sc.path_loss_db = atof(optarg);
+            break;
+        case 'l':
+            sc.link = true;
+            break;
+        case 'B':
+            do_bench = true;
+            break;
+        case 'A':
+            n_air_rates = parse_list(optarg, air_rates, MAX_SWEEP_POINTS);
+            break;
+        case 'k':
+            probes = (unsigned)atoi(optarg);
+            break;
+        case 'i':
+            interval_ms = (unsigned)atoi(optarg);
+            break;
+        case 'z':
+            probe_size = (unsigned)atoi(optarg);
+            break;
+        case 'X':
+            restart_count = (unsigned)atoi(optarg);
+            break;
+        case 'v':
+            sc.verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (do_bench)
+    {
+        if (!n_air_rates || !probes)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        return bench(&sc, air_rates, n_air_rates, probes, interval_ms, probe_size);
+    }
+
+    if (restart_count)
+    {
+        return restart_check(&sc, restart_count);
+    }
+
+    if (do_sweep)
+    {
+        if (!n_counts || !n_rates)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        for (int c = 0; c < n_counts; c++)
+        {
+            if (counts[c] < 1 || counts[c] > SIM_MAX_NODES)
+            {
+                fprintf(stderr, "between 1 and %d nodes\n", SIM_MAX_NODES);
+                return 2;
+            }
+        }
+        if (sc.channel < 0)
+        {
+            sc.channel = BROADCAST_CHANNEL;
+        }
+        if (!sc.buttons)
+        {
+            sc.buttons = TRAFFIC_BROADCAST;
+        }
+        if (!seconds_set)
+        {
+            sc.seconds = SWEEP_SECONDS;
+        }
+        return sweep(&sc, counts, n_counts, rates, n_rates, min_ratio);
+    }
+
+    if (!sc.buttons)
+    {
+        sc.buttons = TRAFFIC_ALL;
+    }
+
+    sim_t sim;
+    result_t res;
+    if (!run_scenario(&sc, &sim, &res))
+    {
+        sim_free(&sim);
+        free(res.lat.samples);
+        return 1;
+    }
+
+    report(&sim, &res, sc.seconds);
+
+    if (dump)
+    {
+        for (int i = 0; i < sim.n_nodes; i++)
+        {
+            printf("\nnode %d display\n", i + 1);
+            ssd1306_model_dump(&sim.nodes[i].oled, stdout);
+        }
+    }
+
+    bool traced = !trace_path || write_trace(&sim, trace_path);
+
+    free(res.lat.samples);
+    sim_free(&sim);
+    return traced ? 0 : 1;
+}
@@ -0,0 +1,312 @@
+/**
+*   Runs several copies of the firmware in one process.
+*
+*   Every node is its own copy of the node module, loaded from a private file
+*   so the dynamic loader gives each one separate globals. The firmware runs on
+*   its own stack and hands the time back whenever it waits (tight_loop_contents,
+*   sleep_ms, a full UART FIFO), the scheduler then advances the virtual clock
+*   in SIM_STEP_US steps, moves the module models and the air, and runs the
+*   interrupts of every node before resuming the ones whose wait is over.
+*/
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+// E32 modules come up at address 0000, 9600 8N1, 2.4k air rate, transparent mode
+static const uint8_t FACTORY_CONFIG[E32_MODEL_CONFIG_LEN] = { 0xC0, 0x00, 0x00, 0x1A, 0x06, 0x44 };
+
+static sim_t *active;
+
+/* Services for the firmware, ctx is the node */
+
+static uint64_t host_now_us(void *ctx)
+{
+    return ((sim_node_t *)ctx)->sim->now_us;
+}
+
+static void host_wait(void *ctx, uint64_t us)
+{
+    sim_node_t *node = ctx;
+    sim_t *sim = node->sim;
+
+    // Interrupt handlers run on the scheduler stack and cannot wait
+    if (sim->running != node)
+    {
+        return;
+    }
+
+    node->wake_us = sim->now_us + (us ? us : 1);
+    swapcontext(&node->context, &sim->main_context);
+}
+
+static void host_gpio_out(void *ctx, unsigned pin, bool level)
+{
+    sim_node_t *node = ctx;
+
+    if (pin == SIM_PIN_M0)
+    {
+        e32_model_set_pins(&node->e32, level, node->e32.m1, node->sim->now_us);
+    }
+    else if (pin == SIM_PIN_M1)
+    {
+        e32_model_set_pins(&node->e32, node->e32.m0, level, node->sim->now_us);
+    }
+}
+
+static void host_uart_baud(void *ctx, unsigned baud)
+{
+    e32_model_set_mcu_baud(&((sim_node_t *)ctx)->e32, baud);
+}
+
+static void host_uart_tx(void *ctx, uint8_t byte)
+{
+    sim_node_t *node = ctx;
+    e32_model_uart_in(&node->e32, byte, node->sim->now_us);
+}
+
+static bool host_i2c_write(void *ctx, uint8_t addr, const uint8_t *data, size_t len)
+{
+    return ssd1306_model_write(&((sim_node_t *)ctx)->oled, addr, data, len);
+}
+
+static void host_log(void *ctx, const char *line)
+{
+    sim_node_t *node = ctx;
+
+    if (node->sim->on_log)
+    {
+        node->sim->on_log(node->sim->log_ctx, node->id, node->sim->now_us, line);
+    }
+}
+
+/* Module pins towards the firmware */
+
+static void module_uart_out(void *ctx, uint8_t byte)
+{
+    ((sim_node_t *)ctx)->api->uart_rx(byte);
+}
+
+static void module_aux_out(void *ctx, bool level)
+{
+    ((sim_node_t *)ctx)->api->gpio_in(SIM_PIN_AUX, level);
+}
+
+// Copies the module to a file of its own, a path the loader has seen before would give back the same globals
+static void *load_copy(const char *path)
+{
+    char copy[] = "/tmp/lora_node_XXXXXX";
+    FILE *in = fopen(path, "rb");
+    int fd = mkstemp(copy);
+
+    if (!in || fd < 0)
+    {
+        fprintf(stderr, "cannot copy %s\n", path);
+        if (in)
+        {
+            fclose(in);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    char buf[65536];
+    size_t n;
+    bool ok = true;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        ok = ok && write(fd, buf, n) == (ssize_t)n;
+    }
+    fclose(in);
+    close(fd);
+
+    void *dl = ok ? dlopen(copy, RTLD_NOW | RTLD_LOCAL) : NULL;
+    if (!dl)
+    {
+        fprintf(stderr, "cannot load %s: %s\n", path, ok ? dlerror() : "write failed");
+    }
+    unlink(copy);
+    return dl;
+}
+
+static void node_entry()
+{
+    active->running->api->run();
+}
+
+// Loads a fresh copy of the firmware and sets it up to start at the next step
+static bool node_boot(sim_node_t *node)
+{
+    node->dl = load_copy(node->sim->module_path);
+    if (!node->dl)
+    {
+        return false;
+    }
+    node->api = dlsym(node->dl, SIM_NODE_API_SYMBOL);
+    if (!node->api)
+    {
+        fprintf(stderr, "%s has no %s\n", node->sim->module_path, SIM_NODE_API_SYMBOL);
+        return false;
+    }
+
+    node->api->attach(&node->host, node->config);
+    node->api->gpio_in(SIM_PIN_AUX, node->e32.aux);
+
+    node->stack = malloc(SIM_STACK_SIZE);
+    if (!node->stack)
+    {
+        return false;
+    }
+    getcontext(&node->context);
+    node->context.uc_stack.ss_sp = node->stack;
+    node->context.uc_stack.ss_size = SIM_STACK_SIZE;
+    node->context.uc_link = &node->sim->main_context;
+    makecontext(&node->context, node_entry, 0);
+    node->wake_us = node->sim->now_us;
+    return true;
+}
+
+static bool node_init(sim_t *sim, sim_node_t *node, int id, const uint8_t config[SIM_CONFIG_LEN])
+{
+    node->sim = sim;
+    node->id = id;
+    memcpy(node->config, config, SIM_CONFIG_LEN);
+
+    node->host = (sim_host_t){
+        .ctx = node,
+        .now_us = host_now_us,
+        .wait = host_wait,
+        .gpio_out = host_gpio_out,
+        .uart_baud = host_uart_baud,
+        .uart_tx = host_uart_tx,
+        .i2c_write = host_i2c_write,
+        .log = host_log,
+    };
+
+    e32_model_io_t io = { node, module_uart_out, module_aux_out };
+    e32_model_init(&node->e32, id, &sim->air, &io, FACTORY_CONFIG);
+    ssd1306_model_init(&node->oled, SIM_OLED_ADDRESS);
+
+    return node_boot(node);
+}
+
+bool sim_init(sim_t *sim, const char *module_path, int n_nodes, const uint8_t (*configs)[SIM_CONFIG_LEN])
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->module_path = module_path;
+    if (n_nodes < 1 || n_nodes > SIM_MAX_NODES)
+    {
+        fprintf(stderr, "between 1 and %d nodes\n", SIM_MAX_NODES);
+        return false;
+    }
+
+    e32_air_init(&sim->air);
+    sim->nodes = calloc((size_t)n_nodes, sizeof(sim_node_t));
+    if (!sim->nodes)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < n_nodes; i++)
+    {
+        sim->n_nodes = i + 1;
+        if (!node_init(sim, &sim->nodes[i], i, configs[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void resume(sim_t *sim, sim_node_t *node)
+{
+    active = sim;
+    sim->running = node;
+    swapcontext(&sim->main_context, &node->context);
+    sim->running = NULL;
+}
+
+void sim_run_until(sim_t *sim, uint64_t end_us)
+{
+    while (sim->now_us < end_us)
+    {
+        for (int i = 0; i < sim->n_nodes; i++)
+        {
+            if (sim->nodes[i].wake_us <= sim->now_us)
+            {
+                resume(sim, &sim->nodes[i]);
+            }
+        }
+
+        sim->now_us += SIM_STEP_US;
+
+        for (int i = 0; i < sim->n_nodes; i++)
+        {
+            e32_model_step(&sim->nodes[i].e32, sim->now_us);
+        }
+        e32_air_step(&sim->air, sim->now_us);
+
+        for (int i = 0; i < sim->n_nodes; i++)
+        {
+            sim_node_t *node = &sim->nodes[i];
+
+            node->api->tick();
+            if (node->pressed_pin && sim->now_us >= node->release_us)
+            {
+                node->api->gpio_in(node->pressed_pin, false);
+                node->pressed_pin = 0;
+            }
+        }
+    }
+}
+
+void sim_press(sim_t *sim, int node_id, unsigned pin)
+{
+    sim_node_t *node = &sim->nodes[node_id];
+
+    if (node->pressed_pin)
+    {
+        node->api->gpio_in(node->pressed_pin, false);
+    }
+    node->api->gpio_in(pin, true);
+    node->pressed_pin = pin;
+    node->release_us = sim->now_us + SIM_BUTTON_PRESS_US;
+}
+
+bool sim_restart(sim_t *sim, int node_id)
+{
+    sim_node_t *node = &sim->nodes[node_id];
+    void *old_dl = node->dl;
+
+    // What the old firmware was doing is dropped with its stack
+    free(node->stack);
+    node->stack = NULL;
+    node->pressed_pin = 0;
+
+    bool ok = node_boot(node);
+    dlclose(old_dl);
+    return ok;
+}
+
+void sim_free(sim_t *sim)
+{
+    for (int i = 0; i < sim->n_nodes; i++)
+    {
+        // Stacks of firmware that is still running are simply dropped
+        free(sim->nodes[i].stack);
+        if (sim->nodes[i].dl)
+        {
+            dlclose(sim->nodes[i].dl);
+        }
+    }
+    free(sim->nodes);
+    sim->nodes = NULL;
+    sim->n_nodes = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <ucontext.h>
+
+#include "e32_model.h"
+#include "sim_api.h"
+#include "ssd1306_model.h"
+
+#define SIM_MAX_NODES E32_AIR_MAX_MODULES
+
+// Resolution of the virtual clock, nodes run their main loop once per step
+#define SIM_STEP_US 100
+
+#define SIM_STACK_SIZE (256 * 1024)
+
+// How long a simulated button press holds the pin high
+#define SIM_BUTTON_PRESS_US 20000
+
+#define SIM_OLED_ADDRESS 0x3C
+
+typedef struct sim sim_t;
+
+// One board: a copy of the firmware, its E32 module and its display
+typedef struct
+{
+    sim_t *sim;
+    int id;
+    void *dl;
+    const sim_node_api_t *api;
+    sim_host_t host;
+    ucontext_t context;
+    void *stack;
+    uint64_t wake_us; // Firmware waits until then
+
+    uint8_t config[SIM_CONFIG_LEN];
+    e32_model_t e32;
+    ssd1306_model_t oled;
+
+    unsigned pressed_pin;
+    uint64_t release_us;
+} sim_node_t;
+
+/**
+*   @brief Called for every line a node prints
+*   @param node Index of the node
+*   @param now_us Virtual time
+*/
+typedef void (*sim_log_cb_t)(void *ctx, int node, uint64_t now_us, const char *line);
+
+struct sim
+{
+    const char *module_path;
+    uint64_t now_us;
+    int n_nodes;
+    sim_node_t *nodes;
+    e32_air_t air;
+
+    ucontext_t main_context;
+    sim_node_t *running;
+
+    sim_log_cb_t on_log;
+    void *log_ctx;
+};
+
+/**
+*   @brief Loads one copy of the node module per node and attaches its module and display models
+*   @param module_path Node module built by the lora_node target
+*   @param configs Configuration each node writes to its module, { SAVE_CONFIG, ADDH, ADDL, SPED, CHAN, OPTION }
+*   @return false if the module could not be loaded
+*
+*   Nodes start running at the first sim_run_until, with the E32 modules
+*   powered up in their factory configuration.
+*/
+bool sim_init(sim_t *sim, const char *module_path, int n_nodes, const uint8_t (*configs)[SIM_CONFIG_LEN]);
+
+// Advances the virtual time, every node, module and the air to end_us
+void sim_run_until(sim_t *sim, uint64_t end_us);
+
+// Presses a button of a node for SIM_BUTTON_PRESS_US
+void sim_press(sim_t *sim, int node, unsigned pin);
+
+/**
+*   @brief Resets the Pico of a node, the firmware starts over with fresh globals
+*   @return false if the module could not be loaded again
+*
+*   The E32 module and the display keep running, like after a press on RUN
+*   or a watchdog reset. Call it between sim_run_until calls only.
+*/
+bool sim_restart(sim_t *sim, int node);
+
+void sim_free(sim_t *sim);
+
+#endif
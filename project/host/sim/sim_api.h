@@ -0,0 +1,122 @@
+#ifndef SIM_API_H
+#define SIM_API_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Wiring of lora_driver.c, the simulation drives the same pins of every node
+#define SIM_PIN_M0 4
+#define SIM_PIN_M1 5
+#define SIM_PIN_AUX 16
+#define SIM_PIN_BROADCAST_BTN 20
+#define SIM_PIN_SEND_MODULE_1_BTN 21
+#define SIM_PIN_SEND_MODULE_2_BTN 22
+
+#define SIM_CONFIG_LEN 6
+
+// Name of the sim_node_api_t exported by every node module
+#define SIM_NODE_API_SYMBOL "sim_node_api"
+
+/**
+*   Services the simulation provides to one node, ctx is passed back unchanged.
+*   All times are virtual microseconds since the start of the simulation.
+*/
+typedef struct
+{
+    void *ctx;
+    uint64_t (*now_us)(void *ctx);
+
+    // Node code is waiting, returns once at least us have passed (0 = until the next step)
+    void (*wait)(void *ctx, uint64_t us);
+
+    // Level driven on an output pin changed
+    void (*gpio_out)(void *ctx, unsigned pin, bool level);
+
+    // UART to the module was set up with another baud rate
+    void (*uart_baud)(void *ctx, unsigned baud);
+
+    // Byte finished shifting out of the UART towards the module
+    void (*uart_tx)(void *ctx, uint8_t byte);
+
+    // One I2C write transaction, returns false if no device acknowledged addr
+    bool (*i2c_write)(void *ctx, uint8_t addr, const uint8_t *data, size_t len);
+
+    // One complete line printed by the node
+    void (*log)(void *ctx, const char *line);
+} sim_host_t;
+
+// Counters of the firmware modules of one node
+typedef struct
+{
+    uint32_t tx_queued;
+    uint32_t tx_sent;
+    uint32_t tx_dropped;
+    uint32_t rel_sent;
+    uint32_t rel_delivered;
+    uint32_t rel_lost;
+    uint32_t rel_retries;
+    uint32_t rel_duplicates;
+    uint32_t frames_ok;
+    uint32_t crc_errors;
+    uint32_t bad_length;
+    uint32_t uart_rx_bytes;
+    uint32_t uart_tx_bytes;
+    uint32_t ring_overruns;
+    uint32_t fifo_overruns;
+    uint32_t ui_queued;
+    uint32_t ui_dropped;
+    uint32_t ui_max_depth;
+    uint32_t power_wakeups;
+    uint32_t power_messages;
+    uint64_t power_awake_us;
+    uint64_t power_asleep_us;
+    uint64_t power_parked_us;
+    uint64_t power_msg_awake_us;
+    bool bench_running;
+    uint32_t bench_sent;
+    uint32_t bench_echoes;
+    uint32_t bench_echo_bytes;
+    uint32_t bench_elapsed_us;
+    uint32_t bench_rtt_p50_us;
+    uint32_t bench_rtt_p99_us;
+    uint32_t bench_rtt_max_us;
+    uint32_t bench_rx_probes;
+    uint32_t bench_rx_missing;
+    uint32_t link_switches;
+    uint32_t link_failures;
+    uint32_t link_fallbacks;
+    uint32_t batch_messages;
+    uint32_t batch_frames;
+    uint32_t batch_max_records;
+    uint32_t batch_dropped;
+} sim_node_stats_t;
+
+// Entry points of a node module, every loaded copy has its own firmware globals
+typedef struct
+{
+    // Connects the node to the simulation and sets the configuration it writes to its module
+    void (*attach)(const sim_host_t *host, const uint8_t config[SIM_CONFIG_LEN]);
+
+    // Firmware main, never returns, gives the time back through host->wait
+    void (*run)(void);
+
+    // Moves the UART and DMA models up to the current time and runs due interrupts
+    void (*tick)(void);
+
+    // Byte from the module finished arriving on the UART RX pin
+    void (*uart_rx)(uint8_t byte);
+
+    // Level on an input pin changed, runs the GPIO interrupt if the edge is enabled
+    void (*gpio_in)(unsigned pin, bool level);
+
+    // Text typed on the USB serial port, read by the console
+    void (*console)(const char *text);
+
+    void (*get_stats)(sim_node_stats_t *stats);
+
+    // Prints the trace ring through host->log, see trace.h
+    void (*trace_dump)(void);
+} sim_node_api_t;
+
+#endif
@@ -0,0 +1,105 @@
+/**
+*   Glue linked into every node module: exposes the firmware of lora_driver.c
+*   to the simulation through sim_node_api_t.
+*/
+
+#include <string.h>
+
+#include "telemetry.h"
+#include "trace.h"
+#include "bench.h"
+#include "link.h"
+
+#include "mock_hal.h"
+#include "sim_api.h"
+
+// Defined in lora_driver.c
+extern const uint8_t *node_config;
+void app_init(void);
+void app_poll(void);
+
+static uint8_t config[SIM_CONFIG_LEN];
+
+static void node_attach(const sim_host_t *host, const uint8_t cfg[SIM_CONFIG_LEN])
+{
+    mock_hal_attach(host);
+    memcpy(config, cfg, sizeof(config));
+    node_config = config;
+}
+
+static void node_run()
+{
+    app_init();
+
+    while (1)
+    {
+        app_poll();
+
+        // Hands the time to the other nodes until the next step
+        tight_loop_contents();
+    }
+}
+
+static void node_get_stats(sim_node_stats_t *stats)
+{
+    telemetry_t t;
+    telemetry_snapshot(&t);
+    bench_stats_t b;
+    bench_get_stats(&b);
+    link_stats_t l;
+    link_get_stats(&l);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->tx_queued = t.tx.queued;
+    stats->tx_sent = t.tx.sent;
+    stats->tx_dropped = t.tx.dropped;
+    stats->rel_sent = t.reliable.sent;
+    stats->rel_delivered = t.reliable.delivered;
+    stats->rel_lost = t.reliable.lost;
+    stats->rel_retries = t.reliable.retries;
+    stats->rel_duplicates = t.reliable.duplicates;
+    stats->frames_ok = t.frames.frames_ok;
+    stats->crc_errors = t.frames.crc_errors;
+    stats->bad_length = t.frames.bad_length;
+    stats->uart_rx_bytes = t.uart.rx_bytes;
+    stats->uart_tx_bytes = t.uart.tx_bytes;
+    stats->ring_overruns = t.uart.ring_overruns;
+    stats->fifo_overruns = t.uart.fifo_overruns;
+    stats->ui_queued = t.ui.queued;
+    stats->ui_dropped = t.ui.dropped;
+    stats->ui_max_depth = t.ui.max_depth;
+    stats->power_wakeups = t.power.wakeups;
+    stats->power_messages = t.power.messages;
+    stats->power_awake_us = t.power.awake_us;
+    stats->power_asleep_us = t.power.asleep_us;
+    stats->power_parked_us = t.power.parked_us;
+    stats->power_msg_awake_us = t.power.msg_awake_us;
+    stats->bench_running = b.running;
+    stats->bench_sent = b.sent;
+    stats->bench_echoes = b.echoes;
+    stats->bench_echo_bytes = b.echo_bytes;
+    stats->bench_elapsed_us = b.elapsed_us;
+    stats->bench_rtt_p50_us = b.rtt_p50_us;
+    stats->bench_rtt_p99_us = b.rtt_p99_us;
+    stats->bench_rtt_max_us = b.rtt_max_us;
+    stats->bench_rx_probes = b.rx_probes;
+    stats->bench_rx_missing = b.rx_missing;
+    stats->link_switches = l.switches;
+    stats->link_failures = l.failures;
+    stats->link_fallbacks = l.fallbacks;
+    stats->batch_messages = t.batch.messages;
+    stats->batch_frames = t.batch.frames;
+    stats->batch_max_records = t.batch.max_records;
+    stats->batch_dropped = t.batch.dropped;
+}
+
+__attribute__((visibility("default"))) const sim_node_api_t sim_node_api = {
+    .attach = node_attach,
+    .run = node_run,
+    .tick = mock_hal_tick,
+    .uart_rx = mock_hal_uart_rx,
+    .gpio_in = mock_hal_gpio_in,
+    .console = mock_hal_console_input,
+    .get_stats = node_get_stats,
+    .trace_dump = trace_dump,
+};
@@ -0,0 +1,185 @@
+#include <string.h>
+
+#include "ssd1306_model.h"
+
+#define CTRL_CONTINUATION 0x80
+#define CTRL_DATA 0x40
+
+#define CMD_SET_MEM_ADDR 0x20
+#define CMD_SET_COL_ADDR 0x21
+#define CMD_SET_PAGE_ADDR 0x22
+#define CMD_SET_DISP_START_LINE 0x40
+#define CMD_SET_CONTRAST 0x81
+#define CMD_SET_CHARGE_PUMP 0x8D
+#define CMD_SET_NORM_INV 0xA6
+#define CMD_SET_DISP 0xAE
+#define CMD_SET_MUX_RATIO 0xA8
+#define CMD_SET_DISP_OFFSET 0xD3
+#define CMD_SET_DISP_CLK_DIV 0xD5
+#define CMD_SET_PRECHARGE 0xD9
+#define CMD_SET_COM_PIN_CFG 0xDA
+#define CMD_SET_VCOM_DESEL 0xDB
+
+void ssd1306_model_init(ssd1306_model_t *d, uint8_t address)
+{
+    memset(d, 0, sizeof(*d));
+    d->address = address;
+    d->col_end = SSD1306_MODEL_WIDTH - 1;
+    d->page_end = SSD1306_MODEL_PAGES - 1;
+}
+
+// Argument bytes following a command byte
+static size_t command_args(uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case CMD_SET_COL_ADDR:
+    case CMD_SET_PAGE_ADDR:
+        return 2;
+    case CMD_SET_MEM_ADDR:
+    case CMD_SET_CONTRAST:
+    case CMD_SET_CHARGE_PUMP:
+    case CMD_SET_MUX_RATIO:
+    case CMD_SET_DISP_OFFSET:
+    case CMD_SET_DISP_CLK_DIV:
+    case CMD_SET_PRECHARGE:
+    case CMD_SET_COM_PIN_CFG:
+    case CMD_SET_VCOM_DESEL:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void execute(ssd1306_model_t *d)
+{
+    const uint8_t *c = d->cmd;
+
+    if (c[0] == CMD_SET_COL_ADDR)
+    {
+        d->col_start = d->col = c[1] & 0x7F;
+        d->col_end = c[2] & 0x7F;
+    }
+    else if (c[0] == CMD_SET_PAGE_ADDR)
+    {
+        d->page_start = d->page = c[1] & 0x07;
+        d->page_end = c[2] & 0x07;
+    }
+    else if ((c[0] & 0xC0) == CMD_SET_DISP_START_LINE)
+    {
+        d->start_line = c[0] & 0x3F;
+    }
+    else if ((c[0] & 0xFE) == CMD_SET_DISP)
+    {
+        d->display_on = c[0] & 0x01;
+    }
+    else if ((c[0] & 0xFE) == CMD_SET_NORM_INV)
+    {
+        d->inverted = c[0] & 0x01;
+    }
+}
+
+static void command_byte(ssd1306_model_t *d, uint8_t byte)
+{
+    if (d->cmd_len == 0)
+    {
+        d->cmd_need = 1 + command_args(byte);
+    }
+    d->cmd[d->cmd_len++] = byte;
+
+    if (d->cmd_len == d->cmd_need)
+    {
+        execute(d);
+        d->cmd_len = 0;
+    }
+    d->stats.cmd_bytes++;
+}
+
+// Writes at the RAM pointer and advances it through the column and page window
+static void data_byte(ssd1306_model_t *d, uint8_t byte)
+{
+    d->ram[d->page][d->col] = byte;
+    d->stats.data_bytes++;
+
+    if (d->col < d->col_end)
+    {
+        d->col++;
+        return;
+    }
+    d->col = d->col_start;
+    d->page = d->page < d->page_end ? d->page + 1 : d->page_start;
+}
+
+bool ssd1306_model_write(ssd1306_model_t *d, uint8_t addr, const uint8_t *data, size_t len)
+{
+    if (addr != d->address)
+    {
+        return false;
+    }
+    d->stats.transactions++;
+
+    bool frame = false;
+    size_t i = 0;
+    while (i < len)
+    {
+        uint8_t control = data[i++];
+
+        // Without the continuation bit everything that follows is of one kind
+        size_t n = control & CTRL_CONTINUATION ? 1 : len - i;
+        for (size_t end = i + n; i < end && i < len; i++)
+        {
+            if (control & CTRL_DATA)
+            {
+                data_byte(d, data[i]);
+                frame = true;
+            }
+            else
+            {
+                command_byte(d, data[i]);
+            }
+        }
+    }
+
+    if (frame)
+    {
+        d->stats.frames++;
+    }
+    return true;
+}
+
+bool ssd1306_model_pixel(const ssd1306_model_t *d, unsigned x, unsigned y)
+{
+    unsigned row = (y + d->start_line) % (SSD1306_MODEL_PAGES * 8);
+    bool on = (d->ram[row / 8][x] >> (row % 8)) & 1;
+    return on != d->inverted;
+}
+
+void ssd1306_model_dump(const ssd1306_model_t *d, FILE *out)
+{
+    static const char cells[] = " '.:";
+
+    fputc('+', out);
+    for (unsigned x = 0; x < SSD1306_MODEL_WIDTH; x++)
+    {
+        fputc('-', out);
+    }
+    fputs("+\n", out);
+
+    for (unsigned y = 0; y < SSD1306_MODEL_PAGES * 8; y += 2)
+    {
+        fputc('|', out);
+        for (unsigned x = 0; x < SSD1306_MODEL_WIDTH; x++)
+        {
+            int cell = ssd1306_model_pixel(d, x, y) | ssd1306_model_pixel(d, x, y + 1) << 1;
+            fputc(d->display_on ? cells[cell] : ' ', out);
+        }
+        fputs("|\n", out);
+    }
+
+    fputc('+', out);
+    for (unsigned x = 0; x < SSD1306_MODEL_WIDTH; x++)
+    {
+        fputc('-', out);
+    }
+    fputs("+\n", out);
+}
@@ -0,0 +1,53 @@
+#ifndef SSD1306_MODEL_H
+#define SSD1306_MODEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SSD1306_MODEL_WIDTH 128
+#define SSD1306_MODEL_PAGES 8
+
+typedef struct
+{
+    uint32_t transactions; // I2C writes addressed to the display
+    uint32_t frames;       // Writes carrying display data
+    uint32_t cmd_bytes;
+    uint32_t data_bytes;
+} ssd1306_model_stats_t;
+
+// Controller state reached through I2C, horizontal addressing only
+typedef struct
+{
+    uint8_t address;
+    uint8_t ram[SSD1306_MODEL_PAGES][SSD1306_MODEL_WIDTH];
+    uint8_t col_start, col_end, col;
+    uint8_t page_start, page_end, page;
+    uint8_t start_line;
+    bool display_on;
+    bool inverted;
+
+    // Command still waiting for its argument bytes
+    uint8_t cmd[3];
+    size_t cmd_len;
+    size_t cmd_need;
+
+    ssd1306_model_stats_t stats;
+} ssd1306_model_t;
+
+void ssd1306_model_init(ssd1306_model_t *d, uint8_t address);
+
+/**
+*   @brief Feeds one I2C write transaction to the display
+*   @return false if the transaction was not addressed to it
+*/
+bool ssd1306_model_write(ssd1306_model_t *d, uint8_t addr, const uint8_t *data, size_t len);
+
+// Pixel as it appears on the panel, start line applied
+bool ssd1306_model_pixel(const ssd1306_model_t *d, unsigned x, unsigned y);
+
+// Prints the panel as text, two rows of pixels per line
+void ssd1306_model_dump(const ssd1306_model_t *d, FILE *out);
+
+#endif
@@ -0,0 +1,187 @@
+/**
+*   Turns the output of the trace console command (trace.h) into the Chrome
+*   trace event format, open it in ui.perfetto.dev or chrome://tracing.
+*
+*   Reads a serial log or a lora_sim -T file, lines that are not part of a dump
+*   are skipped. A "node N: " prefix selects the process, the core the thread.
+*
+*   trace2json [dump.txt] > trace.json
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+#define MAX_NODES 64
+
+typedef struct
+{
+    const char *name;
+    char phase;        // B, E or i
+    const char *arg;   // Name of the argument, NULL if it means nothing
+} event_info_t;
+
+static const event_info_t EVENTS[TRACE_EVENT_COUNT] = {
+    [TRACE_UART_RX] = { "uart rx", 'i', "bytes" },
+    [TRACE_FRAME_OK] = { "frame ok", 'i', "seq" },
+    [TRACE_FRAME_BAD] = { "frame bad", 'i', "dropped" },
+    [TRACE_BUTTON_BEGIN] = { "button", 'B', "gpio" },
+    [TRACE_BUTTON_END] = { "button", 'E', NULL },
+    [TRACE_MODE_BEGIN] = { "mode switch", 'B', "mode" },
+    [TRACE_MODE_END] = { "mode switch", 'E', "ready" },
+    [TRACE_TX_FRAME] = { "tx frame", 'i', "bytes" },
+    [TRACE_AUX] = { "aux", 'i', "level" },
+    [TRACE_UI_POST] = { "ui post", 'i', "chars" },
+    [TRACE_SHOW_BEGIN] = { "display show", 'B', NULL },
+    [TRACE_SHOW_END] = { "display show", 'E', "ok" },
+    [TRACE_SLEEP_BEGIN] = { "sleep", 'B', NULL },
+    [TRACE_SLEEP_END] = { "sleep", 'E', NULL },
+};
+
+// Extends the 32 bit timestamps of one core, records of a core are in time order
+typedef struct
+{
+    bool seen;
+    uint32_t last;
+    uint64_t high;
+} core_clock_t;
+
+static core_clock_t clocks[MAX_NODES][TRACE_CORES];
+static bool named[MAX_NODES][TRACE_CORES];
+static bool first_event = true;
+
+static uint64_t unwrap(core_clock_t *c, uint32_t t)
+{
+    if (c->seen && t < c->last)
+    {
+        c->high += 1ull << 32;
+    }
+    c->seen = true;
+    c->last = t;
+    return c->high | t;
+}
+
+static void emit_metadata(int node, int core)
+{
+    if (core == 0)
+    {
+        printf("%s\n  {\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"node %d\"}}",
+               first_event ? "" : ",", node, node);
+        first_event = false;
+    }
+    printf(",\n  {\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"core %d\"}}", node,
+           core, core);
+}
+
+static void emit_event(int node, const trace_record_t *r, uint64_t ts)
+{
+    const event_info_t *e = &EVENTS[r->event];
+
+    printf("%s\n  {\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":%d,\"tid\":%d", first_event ? "" : ",", e->name,
+           e->phase, (unsigned long long)ts, node, r->core);
+    first_event = false;
+
+    if (e->phase == 'i')
+    {
+        printf(",\"s\":\"t\"");
+    }
+    if (e->arg)
+    {
+        printf(",\"args\":{\"%s\":%u}", e->arg, r->arg);
+    }
+    printf("}");
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+    {
+        fprintf(stderr, "usage: %s [dump.txt] > trace.json\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2 && !(in = fopen(argv[1], "r")))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    unsigned long records = 0;
+    unsigned long lost = 0;
+    unsigned long skipped = 0;
+    char line[256];
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    while (fgets(line, sizeof(line), in))
+    {
+        const char *p = line;
+        int node = 0;
+        int n = 0;
+
+        if (sscanf(p, "node %d: %n", &node, &n) == 1 && n > 0)
+        {
+            p += n;
+        }
+        if (node < 0 || node >= MAX_NODES)
+        {
+            skipped++;
+            continue;
+        }
+
+        unsigned long total;
+        unsigned long overwritten;
+        if (sscanf(p, "trace begin %lx %lx", &total, &overwritten) == 2)
+        {
+            lost += overwritten;
+            continue;
+        }
+
+        unsigned long t;
+        unsigned event;
+        unsigned core;
+        unsigned arg;
+        if (sscanf(p, "T %lx %x %x %x", &t, &event, &core, &arg) != 4)
+        {
+            continue;
+        }
+        if (event == 0 || event >= TRACE_EVENT_COUNT || core >= TRACE_CORES)
+        {
+            skipped++;
+            continue;
+        }
+
+        trace_record_t r = {
+            .time_us = (uint32_t)t,
+            .event = (uint8_t)event,
+            .core = (uint8_t)core,
+            .arg = (uint16_t)arg,
+        };
+
+        if (!named[node][core])
+        {
+            // Core 0 names the process, a node seen on core 1 first gets it too
+            if (core != 0 && !named[node][0])
+            {
+                emit_metadata(node, 0);
+                named[node][0] = true;
+            }
+            emit_metadata(node, core);
+            named[node][core] = true;
+        }
+
+        emit_event(node, &r, unwrap(&clocks[node][core], r.time_us));
+        records++;
+    }
+
+    printf("\n]}\n");
+
+    fprintf(stderr, "%lu events, %lu overwritten on the node, %lu unreadable\n", records, lost, skipped);
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    return 0;
+}
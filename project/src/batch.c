@@ -0,0 +1,297 @@
+#include <string.h>
+
+#include "batch.h"
+#include "frame.h"
+#include "link.h"
+#include "tx_queue.h"
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+typedef struct
+{
+    bool used;
+    bool closed;       // Full or being sent, a newer batch for the destination may be open
+    bool refused;      // The send hook refused a frame of it, held for the next poll
+    uint8_t addr[3];
+    uint8_t count;
+    uint32_t first_us; // First message added
+    uint32_t refused_us;
+    size_t len;
+    uint8_t raw[BATCH_MAX_RAW]; // Length prefixed records
+} batch_t;
+
+static const batch_hooks_t *hooks;
+static batch_t batches[BATCH_SLOTS];
+static batch_stats_t stats;
+
+static bool deadline_passed(uint32_t deadline)
+{
+    return (int32_t)(time_us_32() - deadline) >= 0;
+}
+
+void batch_init(const batch_hooks_t *batch_hooks)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    hooks = batch_hooks;
+    memset(batches, 0, sizeof(batches));
+    restore_interrupts(irq);
+}
+
+// Open batch of a destination, a free slot if it has none. Interrupts must be off.
+static batch_t *find_batch(const uint8_t addr[3])
+{
+    batch_t *free_slot = NULL;
+
+    for (int i = 0; i < BATCH_SLOTS; i++)
+    {
+        batch_t *b = &batches[i];
+        if (b->used && !b->closed && memcmp(b->addr, addr, 3) == 0)
+        {
+            return b;
+        }
+        if (!b->used && !free_slot)
+        {
+            free_slot = b;
+        }
+    }
+    return free_slot;
+}
+
+bool batch_add(uint8_t addhigh, uint8_t addlow, uint8_t channel, const uint8_t *msg, size_t len)
+{
+    const uint8_t addr[3] = { addhigh, addlow, channel };
+    bool ok = false;
+
+    if (len > 255 || len + 1 > BATCH_MAX_RAW)
+    {
+        stats.dropped++;
+        return false;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+    batch_t *b = find_batch(addr);
+
+    // Sent as it is, the message starts the next batch
+    if (b && b->used && b->len + 1 + len > BATCH_MAX_RAW)
+    {
+        b->closed = true;
+        b = find_batch(addr);
+    }
+
+    if (b)
+    {
+        if (!b->used)
+        {
+            memset(b, 0, sizeof(*b));
+            b->used = true;
+            memcpy(b->addr, addr, 3);
+            b->first_us = time_us_32();
+        }
+
+        b->raw[b->len] = (uint8_t)len;
+        memcpy(b->raw + b->len + 1, msg, len);
+        b->len += 1 + len;
+        b->count++;
+        stats.messages++;
+        ok = true;
+    }
+    else
+    {
+        stats.dropped++;
+    }
+    restore_interrupts(irq);
+
+    return ok;
+}
+
+static bool due(const batch_t *b)
+{
+    if (b->closed || b->count >= link_max_records())
+    {
+        return true;
+    }
+    if (deadline_passed(b->first_us + BATCH_MAX_HOLD_MS * 1000))
+    {
+        return true;
+    }
+    return deadline_passed(b->first_us + LORA_BATCH_MS * 1000) && tx_queue_idle();
+}
+
+static void count_frame(size_t records)
+{
+    stats.frames++;
+    if (records > 1)
+    {
+        stats.batched += records;
+    }
+    if (records > stats.max_records)
+    {
+        stats.max_records = records;
+    }
+}
+
+// Keeps the records from offset on for the next poll, drops them if refused for too long
+static bool hold(batch_t *b, size_t offset, size_t records)
+{
+    if (b->refused && deadline_passed(b->refused_us + BATCH_MAX_HOLD_MS * 1000))
+    {
+        stats.dropped += records;
+        return true;
+    }
+
+    memmove(b->raw, b->raw + offset, b->len - offset);
+    b->len -= offset;
+    b->count = (uint8_t)records;
+    if (!b->refused)
+    {
+        b->refused = true;
+        b->refused_us = time_us_32();
+    }
+    stats.busy++;
+    return false;
+}
+
+// Sends the records in as few frames as fit, in order. Returns false if the batch is held for a refused frame.
+static bool flush(batch_t *b)
+{
+    size_t starts[BATCH_MAX_RAW / 2 + 1];
+    size_t n = 0;
+
+    for (size_t offset = 0; offset < b->len; offset += 1 + b->raw[offset])
+    {
+        starts[n++] = offset;
+    }
+    starts[n] = b->len;
+
+    size_t first = 0;
+    while (first < n)
+    {
+        size_t last = n;
+        batch_send_status_t status = BATCH_SEND_TOO_LONG;
+
+        // Fewer records until the compressed list fits, a single one goes without the record header
+        while (last > first + 1 &&
+               (status = hooks->send(b->addr[0], b->addr[1], b->addr[2], FRAME_FLAG_RECORDS, b->raw + starts[first],
+                                     starts[last] - starts[first])) == BATCH_SEND_TOO_LONG)
+        {
+            last--;
+        }
+        if (last == first + 1)
+        {
+            status = hooks->send(b->addr[0], b->addr[1], b->addr[2], 0, b->raw + starts[first] + 1, b->raw[starts[first]]);
+        }
+
+        if (status == BATCH_SEND_BUSY)
+        {
+            return hold(b, starts[first], n - first);
+        }
+        if (status == BATCH_SEND_TOO_LONG)
+        {
+            stats.dropped++;
+        }
+        else
+        {
+            count_frame(last - first);
+        }
+        first = last;
+    }
+    return true;
+}
+
+void batch_poll()
+{
+    // Each batch is tried once per poll, a refused one waits for the window to open
+    bool tried[BATCH_SLOTS] = { false };
+
+    while (1)
+    {
+        batch_t out;
+        batch_t *oldest = NULL;
+
+        // Oldest first, a full batch goes before the newer one of its destination
+        uint32_t irq = save_and_disable_interrupts();
+        for (int i = 0; i < BATCH_SLOTS; i++)
+        {
+            batch_t *b = &batches[i];
+            if (b->used && !tried[i] && due(b) && (!oldest || (int32_t)(b->first_us - oldest->first_us) < 0))
+            {
+                oldest = b;
+            }
+        }
+        if (oldest)
+        {
+            tried[oldest - batches] = true;
+
+            // Messages added while it is sent open the next batch
+            oldest->closed = true;
+            out = *oldest;
+        }
+        restore_interrupts(irq);
+
+        if (!oldest)
+        {
+            return;
+        }
+
+        bool done = flush(&out);
+
+        irq = save_and_disable_interrupts();
+        if (done)
+        {
+            oldest->used = false;
+        }
+        else
+        {
+            *oldest = out;
+
+            // Newer batches of the destination stay behind it
+            for (int i = 0; i < BATCH_SLOTS; i++)
+            {
+                if (memcmp(batches[i].addr, out.addr, 3) == 0)
+                {
+                    tried[i] = true;
+                }
+            }
+        }
+        restore_interrupts(irq);
+    }
+}
+
+bool batch_next_deadline(uint32_t *deadline)
+{
+    bool found = false;
+
+    uint32_t irq = save_and_disable_interrupts();
+    for (int i = 0; i < BATCH_SLOTS; i++)
+    {
+        const batch_t *b = &batches[i];
+        uint32_t t = b->first_us + LORA_BATCH_MS * 1000;
+
+        // Held for the module, the cap is next
+        if (deadline_passed(t))
+        {
+            t = b->first_us + BATCH_MAX_HOLD_MS * 1000;
+        }
+        // Refused by the send hook, retried whenever the core runs and dropped at the cap
+        if (b->refused)
+        {
+            t = b->refused_us + BATCH_MAX_HOLD_MS * 1000;
+        }
+        if (b->used && (!found || (int32_t)(t - *deadline) < 0))
+        {
+            *deadline = t;
+            found = true;
+        }
+    }
+    restore_interrupts(irq);
+
+    return found;
+}
+
+void batch_get_stats(batch_stats_t *out)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    *out = stats;
+    restore_interrupts(irq);
+}
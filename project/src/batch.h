@@ -0,0 +1,93 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "compress.h"
+
+/**
+*   TX batching: messages to the same destination are collected and sent as
+*   one FRAME_FLAG_RECORDS frame, so they share the packet preamble, the
+*   address header and the frame overhead.
+*
+*   A batch goes out LORA_BATCH_MS after its first message if the module is
+*   idle, or right away once it holds link_max_records() messages or the next
+*   message does not fit. While the module is still sending earlier frames it
+*   is held past that, the frame could not leave earlier and messages coming
+*   in meanwhile join it, but never longer than BATCH_MAX_HOLD_MS.
+*   Records that do not fit into one frame after compression go in the next.
+*   A batch of one message is sent as a plain frame.
+*
+*   A frame the send hook refuses for a full window or queue keeps its batch,
+*   closed to new messages, and is tried again on the next batch_poll. Its
+*   records are dropped once BATCH_MAX_HOLD_MS passed since the first refusal.
+*/
+#ifndef LORA_BATCH_MS
+#define LORA_BATCH_MS 50
+#endif
+
+// A batch waits at most this long for the module, under steady traffic it would never be idle
+#define BATCH_MAX_HOLD_MS (2 * LORA_BATCH_MS)
+
+// Batches open at once, a full batch and the next one for the same destination take two
+#define BATCH_SLOTS 6
+
+// Record list of a batch before compression, the receiver decompresses into as much
+#define BATCH_MAX_RAW COMPRESS_MAX_RAW
+
+typedef struct
+{
+    uint32_t messages;    // Messages accepted by batch_add
+    uint32_t frames;      // Frames handed to the send hook
+    uint32_t batched;     // Messages that shared their frame with others
+    uint32_t max_records; // Most messages in one frame
+    uint32_t busy;        // Frames refused by the send hook for the moment, tried again later
+    uint32_t dropped;     // Messages too long for a frame, refused with every slot taken or refused too long
+} batch_stats_t;
+
+typedef enum
+{
+    BATCH_SEND_OK,
+    BATCH_SEND_BUSY,    // The window or queue is full, nothing was sent
+    BATCH_SEND_TOO_LONG // The payload does not fit into one frame, nothing was sent
+} batch_send_status_t;
+
+typedef struct
+{
+    /**
+    *   @brief Frames and sends a payload
+    *   @param flags FRAME_FLAG_RECORDS for a record list, 0 for a single message
+    */
+    batch_send_status_t (*send)(uint8_t addhigh, uint8_t addlow, uint8_t channel, uint8_t flags, const uint8_t *raw,
+                                size_t len);
+} batch_hooks_t;
+
+/**
+*   @brief Drops open batches and sets how frames are sent
+*   @param hooks Frames and queues a payload
+*/
+void batch_init(const batch_hooks_t *hooks);
+
+/**
+*   @brief Adds a message to the batch of its destination, safe to call from interrupts
+*   @param addhigh, addlow, channel Destination
+*   @param msg Message bytes, copied
+*   @param len Message length, at most 255 and BATCH_MAX_RAW - 1
+*   @return false if the message was dropped
+*/
+bool batch_add(uint8_t addhigh, uint8_t addlow, uint8_t channel, const uint8_t *msg, size_t len);
+
+// Sends the batches that are due, oldest first, call from the main loop
+void batch_poll(void);
+
+/**
+*   @brief Time the next open batch is due, its hold limit once LORA_BATCH_MS passed
+*   @return false if no batch is open
+*/
+bool batch_next_deadline(uint32_t *deadline);
+
+void batch_get_stats(batch_stats_t *stats);
+
+#endif
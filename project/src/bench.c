@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "tx_queue.h"
+
+#include "pico/stdlib.h"
+
+// First payload byte
+#define KIND_PROBE 1      // Counted by the receivers, not echoed
+#define KIND_PROBE_ECHO 2 // Echoed by the destination
+#define KIND_ECHO 3
+
+typedef struct
+{
+    uint8_t addr[3];
+    bool echo;
+    uint8_t id;
+    uint32_t count;
+    uint32_t interval_us;
+    size_t size;
+    uint32_t start_us;
+    uint32_t next_us;      // Next probe with an interval
+    uint32_t deadline;     // Echo timeout of the last probe
+    bool last_refused;
+    size_t refused_depth;  // TX queue depth when the last probe was refused
+    uint32_t retry_us;     // The refused probe is tried again at the latest then
+} run_t;
+
+static uint8_t self_addr[3];
+static uint8_t air_rate;
+static uint8_t frame_seq = 0;
+
+static run_t run;
+static uint8_t next_id;
+static bench_stats_t stats;
+
+// Round trips in the order the echoes arrived, sorted when the run ends
+static uint32_t rtt_us[BENCH_MAX_PROBES];
+static uint8_t echoed[BENCH_MAX_PROBES / 8];
+
+// Run being received
+static bool rx_valid = false;
+static uint8_t rx_src[3];
+static uint8_t rx_id;
+static uint32_t rx_next_seq;
+static uint32_t rx_first_us;
+
+static bool deadline_passed(uint32_t deadline)
+{
+    return (int32_t)(time_us_32() - deadline) >= 0;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+void bench_init(const uint8_t config[E32_CONFIG_LEN])
+{
+    self_addr[0] = config[1];
+    self_addr[1] = config[2];
+    self_addr[2] = config[4];
+    air_rate = config[3] & 0x07;
+
+    // Receivers tell runs apart by their number, also across restarts of the sender
+    if (next_id == 0)
+    {
+        next_id = (uint8_t)(time_us_32() | 1);
+    }
+}
+
+bool bench_start(uint8_t addhigh, uint8_t addlow, uint8_t channel, uint32_t count, uint32_t interval_ms, size_t size)
+{
+    if (count == 0 || count > BENCH_MAX_PROBES || size < BENCH_HEADER_LEN || size > FRAME_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    run = (run_t){
+        .addr = { addhigh, addlow, channel },
+        .echo = !(addhigh == 0xFF && addlow == 0xFF),
+        .id = next_id++,
+        .count = count,
+        .interval_us = interval_ms * 1000,
+        .size = size,
+        .next_us = time_us_32(),
+    };
+    memset(echoed, 0, sizeof(echoed));
+
+    // Received counters are kept, they belong to another node's run
+    stats.running = true;
+    stats.air_rate = air_rate;
+    stats.sent = 0;
+    stats.refused = 0;
+    stats.echoes = 0;
+    stats.echo_bytes = 0;
+    stats.elapsed_us = 0;
+    stats.rtt_p50_us = 0;
+    stats.rtt_p99_us = 0;
+    stats.rtt_max_us = 0;
+    return true;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest rank of a sorted set, pct in percent
+static uint32_t percentile(const uint32_t *sorted, uint32_t n, uint32_t pct)
+{
+    return n ? sorted[((n - 1) * pct + 50) / 100] : 0;
+}
+
+void bench_stop()
+{
+    if (!stats.running)
+    {
+        return;
+    }
+
+    stats.running = false;
+    qsort(rtt_us, stats.echoes, sizeof(uint32_t), compare_u32);
+    stats.rtt_p50_us = percentile(rtt_us, stats.echoes, 50);
+    stats.rtt_p99_us = percentile(rtt_us, stats.echoes, 99);
+    stats.rtt_max_us = percentile(rtt_us, stats.echoes, 100);
+
+    bench_print();
+}
+
+static void send_probe()
+{
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    uint8_t frame[FRAME_MAX_LEN];
+    uint32_t seq = stats.sent;
+    uint32_t now = time_us_32();
+
+    payload[0] = run.echo ? KIND_PROBE_ECHO : KIND_PROBE;
+    payload[1] = run.id;
+    payload[2] = (uint8_t)(seq >> 8);
+    payload[3] = (uint8_t)seq;
+    put_u32(payload + 4, now);
+    for (size_t i = BENCH_HEADER_LEN; i < run.size; i++)
+    {
+        payload[i] = (uint8_t)i;
+    }
+
+    size_t len = frame_encode(frame, FRAME_FLAG_PROBE, self_addr, frame_seq, payload, run.size);
+    run.last_refused = !tx_queue_push(run.addr[0], run.addr[1], run.addr[2], frame, len);
+
+    // Tried again with the same number once a frame left the queue or a probe interval passed
+    if (run.last_refused)
+    {
+        stats.refused++;
+        run.refused_depth = tx_queue_depth();
+        run.retry_us = now + (run.interval_us ? run.interval_us : BENCH_ECHO_TIMEOUT_MS * 1000);
+        return;
+    }
+    frame_seq++;
+
+    if (seq == 0)
+    {
+        run.start_us = now;
+    }
+    if (!run.echo)
+    {
+        stats.elapsed_us = now - run.start_us;
+    }
+
+    stats.sent++;
+    run.next_us += run.interval_us;
+    run.deadline = now + BENCH_ECHO_TIMEOUT_MS * 1000;
+}
+
+static bool was_echoed(uint32_t seq)
+{
+    return echoed[seq / 8] & (1u << (seq % 8));
+}
+
+void bench_poll()
+{
+    if (!stats.running)
+    {
+        return;
+    }
+
+    if (stats.sent < run.count)
+    {
+        bool due;
+
+        if (run.last_refused)
+        {
+            due = tx_queue_depth() < run.refused_depth || deadline_passed(run.retry_us);
+        }
+        else if (run.interval_us)
+        {
+            due = deadline_passed(run.next_us);
+        }
+        else if (run.echo)
+        {
+            due = stats.sent == 0 || was_echoed(stats.sent - 1) || deadline_passed(run.deadline);
+        }
+        else
+        {
+            due = tx_queue_idle();
+        }
+
+        if (due)
+        {
+            send_probe();
+        }
+        return;
+    }
+
+    bool done = run.echo ? stats.echoes == stats.sent || deadline_passed(run.deadline)
+                         : tx_queue_idle();
+    if (done)
+    {
+        bench_stop();
+    }
+}
+
+// Probe of another node, counted per run and echoed if asked for
+static void on_probe(const frame_t *frame)
+{
+    const uint8_t src[3] = { frame->src_high, frame->src_low, frame->src_channel };
+    const uint8_t *p = frame->payload;
+    uint32_t seq = (uint32_t)p[2] << 8 | p[3];
+    uint32_t now = time_us_32();
+
+    if (!rx_valid || memcmp(rx_src, src, 3) != 0 || rx_id != p[1])
+    {
+        rx_valid = true;
+        memcpy(rx_src, src, 3);
+        rx_id = p[1];
+        rx_next_seq = 0;
+        rx_first_us = now;
+        stats.rx_probes = 0;
+        stats.rx_missing = 0;
+        stats.rx_bytes = 0;
+        stats.echoes_sent = 0;
+    }
+
+    // Probes are never retransmitted, an older sequence number can only be a stray copy
+    if (seq < rx_next_seq)
+    {
+        return;
+    }
+    stats.rx_missing += seq - rx_next_seq;
+    rx_next_seq = seq + 1;
+    stats.rx_probes++;
+    stats.rx_bytes += frame->len;
+    stats.rx_elapsed_us = now - rx_first_us;
+
+    if (p[0] != KIND_PROBE_ECHO)
+    {
+        return;
+    }
+
+    uint8_t payload[FRAME_MAX_PAYLOAD];
+    uint8_t echo[FRAME_MAX_LEN];
+    memcpy(payload, p, frame->len);
+    payload[0] = KIND_ECHO;
+
+    size_t len = frame_encode(echo, FRAME_FLAG_PROBE, self_addr, frame_seq++, payload, frame->len);
+    if (tx_queue_push(src[0], src[1], src[2], echo, len))
+    {
+        stats.echoes_sent++;
+    }
+}
+
+// Echo of an own probe, one round trip sample per probe of the current run
+static void on_echo(const frame_t *frame)
+{
+    const uint8_t *p = frame->payload;
+    uint32_t seq = (uint32_t)p[2] << 8 | p[3];
+
+    if (!stats.running || p[1] != run.id || seq >= stats.sent || was_echoed(seq) ||
+        frame->src_high != run.addr[0] || frame->src_low != run.addr[1])
+    {
+        return;
+    }
+
+    uint32_t now = time_us_32();
+    echoed[seq / 8] |= (uint8_t)(1u << (seq % 8));
+    rtt_us[stats.echoes++] = now - get_u32(p + 4);
+    stats.echo_bytes += frame->len;
+    stats.elapsed_us = now - run.start_us;
+}
+
+void bench_on_frame(const frame_t *frame)
+{
+    if (frame->len < BENCH_HEADER_LEN)
+    {
+        return;
+    }
+
+    if (frame->payload[0] == KIND_ECHO)
+    {
+        on_echo(frame);
+    }
+    else
+    {
+        on_probe(frame);
+    }
+}
+
+bool bench_next_deadline(uint32_t *deadline)
+{
+    if (!stats.running)
+    {
+        return false;
+    }
+
+    *deadline = stats.sent < run.count && run.interval_us ? run.next_us : run.deadline;
+    return true;
+}
+
+void bench_get_stats(bench_stats_t *out)
+{
+    *out = stats;
+}
+
+static unsigned long per_second(uint32_t bytes, uint32_t us)
+{
+    return us ? (unsigned long)((uint64_t)bytes * 1000000 / us) : 0;
+}
+
+// Tenths of a percent
+static unsigned long permille(uint32_t n, uint32_t total)
+{
+    return total ? (unsigned long)((uint64_t)n * 1000 / total) : 0;
+}
+
+void bench_print()
+{
+    if (stats.sent)
+    {
+        unsigned long loss = permille(stats.sent - stats.echoes, stats.sent);
+
+        printf("[bench] to %02X%02X chan %02X, air rate %u: sent %lu  %s %lu  refused %lu  loss %lu.%lu %%\n",
+               run.addr[0], run.addr[1], run.addr[2], stats.air_rate, (unsigned long)stats.sent,
+               run.echo ? "echoed" : "unechoed", (unsigned long)(run.echo ? stats.echoes : 0),
+               (unsigned long)stats.refused, run.echo ? loss / 10 : 0, run.echo ? loss % 10 : 0);
+
+        if (stats.running)
+        {
+            printf("[bench] running, %lu of %lu probes sent\n", (unsigned long)stats.sent, (unsigned long)run.count);
+        }
+        else if (run.echo)
+        {
+            printf("[bench] round trip p50 %lu ms  p99 %lu ms  max %lu ms  goodput %lu B/s\n",
+                   (unsigned long)(stats.rtt_p50_us / 1000), (unsigned long)(stats.rtt_p99_us / 1000),
+                   (unsigned long)(stats.rtt_max_us / 1000), per_second(stats.echo_bytes, stats.elapsed_us));
+        }
+    }
+
+    if (rx_valid)
+    {
+        unsigned long loss = permille(stats.rx_missing, stats.rx_probes + stats.rx_missing);
+
+        printf("[bench] from %02X%02X chan %02X: probes %lu  missing %lu  loss %lu.%lu %%  goodput %lu B/s  echoed %lu\n",
+               rx_src[0], rx_src[1], rx_src[2], (unsigned long)stats.rx_probes, (unsigned long)stats.rx_missing,
+               loss / 10, loss % 10, per_second(stats.rx_bytes, stats.rx_elapsed_us),
+               (unsigned long)stats.echoes_sent);
+    }
+
+    if (!stats.sent && !rx_valid)
+    {
+        printf("[bench] no run yet\n");
+    }
+}
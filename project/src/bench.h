@@ -0,0 +1,92 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+#include "e32.h"
+
+/**
+*   Link benchmark, started with the bench console command.
+*
+*   The sender queues FRAME_FLAG_PROBE frames at a fixed interval, or one
+*   after the other with interval 0. Every probe carries a run number, a
+*   sequence number and the time it was queued. The destination echoes probes
+*   addressed to it with the same length, so the sender measures the round
+*   trip from queueing the probe (where send_msg queues a message) to parsing
+*   the echo (where a message would be shown) with its own clock. Broadcast
+*   probes are not echoed, the receivers count them.
+*
+*   Probe payload: kind | run | sequence high, low | queued us (4, big endian) | filler
+*/
+#define BENCH_HEADER_LEN 8
+
+// Probes of one run, one round trip sample is kept per probe
+#define BENCH_MAX_PROBES 512
+
+// Echoes are waited for this long after the last probe, and per probe with interval 0
+#define BENCH_ECHO_TIMEOUT_MS 10000
+
+typedef struct
+{
+    bool running;
+    uint8_t air_rate;       // Air rate bits of the speed byte of the last run
+
+    // Last run started on this node
+    uint32_t sent;          // Probes queued
+    uint32_t refused;       // Pushes the full TX queue refused, the probe was tried again later
+    uint32_t echoes;        // Probes echoed back
+    uint32_t echo_bytes;    // Payload bytes of the echoed probes
+    uint32_t elapsed_us;    // First probe queued to the last echo, or to the last probe without echoes
+    uint32_t rtt_p50_us;    // Round trip percentiles, set when the run ends
+    uint32_t rtt_p99_us;
+    uint32_t rtt_max_us;
+
+    // Last run heard from another node
+    uint32_t rx_probes;
+    uint32_t rx_missing;    // Sequence numbers skipped
+    uint32_t rx_bytes;
+    uint32_t rx_elapsed_us; // First to last probe received
+    uint32_t echoes_sent;
+} bench_stats_t;
+
+/**
+*   @brief Sets the source address of the probes and the air rate reported with the results
+*   @param config Module configuration in use, { SAVE_CONFIG, ADDH, ADDL, SPED, CHAN, OPTION }
+*/
+void bench_init(const uint8_t config[E32_CONFIG_LEN]);
+
+/**
+*   @brief Starts a run, a run in progress is abandoned
+*   @param addhigh, addlow, channel Destination, FFFF sends probes without echo
+*   @param count Probes to send, at most BENCH_MAX_PROBES
+*   @param interval_ms Time between probes, 0 = next probe once the previous one was echoed or sent
+*   @param size Payload bytes per probe, BENCH_HEADER_LEN to FRAME_MAX_PAYLOAD
+*   @return false if a parameter is out of range
+*/
+bool bench_start(uint8_t addhigh, uint8_t addlow, uint8_t channel, uint32_t count, uint32_t interval_ms, size_t size);
+
+// Ends the run in progress and prints what it measured
+void bench_stop(void);
+
+// Queues due probes and ends the run once every echo arrived or timed out, call from the main loop
+void bench_poll(void);
+
+// Counts a received probe and echoes it, or records the round trip of an echo. For FRAME_FLAG_PROBE frames.
+void bench_on_frame(const frame_t *frame);
+
+/**
+*   @brief Time the running benchmark needs bench_poll again
+*   @param deadline Set to the next probe or echo timeout
+*   @return false if no run is in progress
+*/
+bool bench_next_deadline(uint32_t *deadline);
+
+void bench_get_stats(bench_stats_t *stats);
+
+// Prints the results of the last runs sent and received on stdio
+void bench_print(void);
+
+#endif
@@ -0,0 +1,193 @@
+#include <string.h>
+
+#include "compress.h"
+
+#define DICT_BASE 0x80
+#define REF_BASE 0xC0
+#define ESCAPE 0xFF
+#define REF_MIN 3
+#define REF_MAX (REF_MIN + (ESCAPE - REF_BASE) - 1)
+#define WINDOW 255
+
+typedef struct
+{
+    const char *text;
+    uint8_t len;
+} dict_entry_t;
+
+#define D(s) { s, sizeof(s) - 1 }
+
+// Fragments common in our messages and in sensor key=value or JSON telemetry, at most 64
+static const dict_entry_t dict[] = {
+    D("Hello"), D("Node "), D("everyone"), D(", "), D("! "), D("temp"), D("hum"), D("batt"),
+    D("rssi"), D("snr"), D("volt"), D("press"), D("alarm"), D("status"), D("ok"), D("OK"),
+    D("error"), D("node"), D("seq"), D("time"), D("lat"), D("lon"), D("alt"), D("speed"),
+    D("level"), D("water"), D("soil"), D("light"), D("door"), D("open"), D("closed"), D("on"),
+    D("off"), D("low"), D("high"), D("mV"), D("mA"), D("hPa"), D("dBm"), D("km/h"),
+    D("%RH"), D(".0"), D(".5"), D("00"), D("0."), D("1."), D("2."), D("-1"),
+    D("=1"), D("=2"), D("=0"), D("\":"), D("\",\""), D("{\""), D("\"}"), D("true"),
+    D("false"), D("ing"), D("the "), D("tion"), D("id"), D("er"), D("C "), D("V "),
+};
+
+_Static_assert(sizeof(dict) / sizeof(dict[0]) <= REF_BASE - DICT_BASE, "dictionary too large");
+
+static size_t dict_lz_encode(const uint8_t *in, size_t len, uint8_t *out, size_t max)
+{
+    size_t o = 0;
+    size_t i = 0;
+
+    while (i < len)
+    {
+        // Bytes saved compared to literals, a dictionary code costs 1 byte and a reference 2
+        size_t best_gain = 0;
+        size_t best_len = 1;
+        int best_dict = -1;
+        size_t best_dist = 0;
+
+        for (size_t d = 0; d < sizeof(dict) / sizeof(dict[0]); d++)
+        {
+            size_t n = dict[d].len;
+            if (n - 1 > best_gain && n <= len - i && memcmp(in + i, dict[d].text, n) == 0)
+            {
+                best_gain = n - 1;
+                best_len = n;
+                best_dict = d;
+            }
+        }
+
+        for (size_t j = i > WINDOW ? i - WINDOW : 0; j < i; j++)
+        {
+            size_t n = 0;
+            while (i + n < len && n < REF_MAX && in[j + n] == in[i + n])
+            {
+                n++;
+            }
+            if (n >= REF_MIN && n - 2 > best_gain)
+            {
+                best_gain = n - 2;
+                best_len = n;
+                best_dict = -1;
+                best_dist = i - j;
+            }
+        }
+
+        if (best_gain == 0)
+        {
+            if (in[i] < DICT_BASE)
+            {
+                if (o + 1 > max)
+                {
+                    return 0;
+                }
+                out[o++] = in[i];
+            }
+            else
+            {
+                if (o + 2 > max)
+                {
+                    return 0;
+                }
+                out[o++] = ESCAPE;
+                out[o++] = in[i];
+            }
+            i++;
+        }
+        else if (best_dict >= 0)
+        {
+            if (o + 1 > max)
+            {
+                return 0;
+            }
+            out[o++] = DICT_BASE + best_dict;
+            i += best_len;
+        }
+        else
+        {
+            if (o + 2 > max)
+            {
+                return 0;
+            }
+            out[o++] = REF_BASE + (best_len - REF_MIN);
+            out[o++] = (uint8_t)best_dist;
+            i += best_len;
+        }
+    }
+
+    return o;
+}
+
+static size_t dict_lz_decode(const uint8_t *in, size_t len, uint8_t *out, size_t max)
+{
+    size_t o = 0;
+    size_t i = 0;
+
+    while (i < len)
+    {
+        uint8_t b = in[i++];
+
+        if (b < DICT_BASE)
+        {
+            if (o + 1 > max)
+            {
+                return 0;
+            }
+            out[o++] = b;
+        }
+        else if (b < REF_BASE)
+        {
+            size_t d = b - DICT_BASE;
+            if (d >= sizeof(dict) / sizeof(dict[0]) || o + dict[d].len > max)
+            {
+                return 0;
+            }
+            memcpy(out + o, dict[d].text, dict[d].len);
+            o += dict[d].len;
+        }
+        else if (b < ESCAPE)
+        {
+            size_t n = (b - REF_BASE) + REF_MIN;
+            if (i >= len || o + n > max)
+            {
+                return 0;
+            }
+            size_t dist = in[i++];
+            if (dist == 0 || dist > o)
+            {
+                return 0;
+            }
+            // Byte by byte, a reference may overlap the bytes it produces
+            for (size_t k = 0; k < n; k++, o++)
+            {
+                out[o] = out[o - dist];
+            }
+        }
+        else
+        {
+            if (i >= len || o + 1 > max)
+            {
+                return 0;
+            }
+            out[o++] = in[i++];
+        }
+    }
+
+    return o;
+}
+
+const codec_t codec_dict_lz = {
+    .id = CODEC_DICT_LZ,
+    .name = "dict_lz",
+    .encode = dict_lz_encode,
+    .decode = dict_lz_decode,
+};
+
+const codec_t *codec_get(uint8_t id)
+{
+    switch (id)
+    {
+    case CODEC_DICT_LZ:
+        return &codec_dict_lz;
+    default:
+        return NULL;
+    }
+}
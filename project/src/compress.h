@@ -0,0 +1,36 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Codec ids, carried in the FRAME_CODEC bits of the frame flags
+#define CODEC_NONE 0
+#define CODEC_DICT_LZ 1
+
+// Largest message a compressed frame may expand to
+#define COMPRESS_MAX_RAW 128
+
+/**
+*   A payload codec. Both functions return the number of bytes written to out,
+*   or 0 if the result does not fit into max bytes or the input is malformed.
+*/
+typedef struct
+{
+    uint8_t id;
+    const char *name;
+    size_t (*encode)(const uint8_t *in, size_t len, uint8_t *out, size_t max);
+    size_t (*decode)(const uint8_t *in, size_t len, uint8_t *out, size_t max);
+} codec_t;
+
+/**
+*   Static dictionary + small window LZ, tuned for short telemetry strings:
+*   00-7F literal, 80-BF dictionary entry, C0-FE back reference of 3-65 bytes
+*   followed by a distance byte (1-255), FF escape followed by a literal byte.
+*/
+extern const codec_t codec_dict_lz;
+
+// Returns the codec with the given id, NULL for CODEC_NONE or unknown ids
+const codec_t *codec_get(uint8_t id);
+
+#endif
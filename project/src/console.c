@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "console.h"
+#include "e32.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "bench.h"
+#include "link.h"
+
+#include "pico/stdlib.h"
+
+// Words of a command, the last one keeps the rest of the line
+#define MAX_ARGS 6
+
+typedef struct
+{
+    const char *name;
+    const char *args;
+    const char *help;
+    int min_args; // Words after the command
+    void (*run)(int argc, char **argv);
+} command_t;
+
+static const node_settings_t *live;
+static const console_hooks_t *hooks;
+
+// Settings being edited, copied from live after every save or reset
+static node_settings_t edit;
+
+static char line[CONSOLE_LINE_MAX];
+static size_t line_len = 0;
+static bool line_overflow = false;
+
+static const char *const button_names[NODE_STORE_PEERS] = { "broadcast", "send module 1", "send module 2" };
+
+// Parses a hex byte, false if the word is not one
+static bool parse_byte(const char *word, uint8_t *value)
+{
+    char *end;
+    unsigned long v = strtoul(word, &end, 16);
+
+    if (end == word || *end != '\0' || v > 0xFF)
+    {
+        printf("not a hex byte: %s\n", word);
+        return false;
+    }
+    *value = (uint8_t)v;
+    return true;
+}
+
+// Parses a decimal number, false if the word is not one
+static bool parse_number(const char *word, uint32_t *value)
+{
+    char *end;
+    unsigned long v = strtoul(word, &end, 10);
+
+    if (end == word || *end != '\0')
+    {
+        printf("not a number: %s\n", word);
+        return false;
+    }
+    *value = (uint32_t)v;
+    return true;
+}
+
+static void print_config(const char *what, const uint8_t *config)
+{
+    printf("%-8s addr %02X%02X  chan %02X  speed %02X  option %02X\n", what, config[1], config[2], config[4],
+           config[3], config[5]);
+}
+
+static void cmd_show(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    print_config("active", live->config);
+    print_config("edited", edit.config);
+    print_config("module", e32_config_current());
+
+    for (int i = 0; i < NODE_STORE_PEERS; i++)
+    {
+        const node_peer_t *p = &edit.peers[i];
+        printf("peer %d (%s): %02X%02X chan %02X \"%s\"\n", i, button_names[i], p->addh, p->addl, p->chan, p->msg);
+    }
+
+    if (memcmp(&edit, live, sizeof(edit)) != 0)
+    {
+        printf("unsaved changes, use save\n");
+    }
+}
+
+static void cmd_addr(int argc, char **argv)
+{
+    (void)argc;
+    uint8_t high, low;
+
+    if (!parse_byte(argv[1], &high) || !parse_byte(argv[2], &low))
+    {
+        return;
+    }
+
+    // FFFF is the broadcast address, frames and acknowledgements need a source of their own
+    if (high == 0xFF && low == 0xFF)
+    {
+        printf("FFFF is the broadcast address\n");
+        return;
+    }
+    edit.config[1] = high;
+    edit.config[2] = low;
+}
+
+// Channel byte the module can tune to, false with a message otherwise
+static bool parse_channel(const char *word, uint8_t *value)
+{
+    if (!parse_byte(word, value))
+    {
+        return false;
+    }
+    if (*value > E32_CHANNEL_MAX)
+    {
+        printf("channel is 00 to %02X\n", E32_CHANNEL_MAX);
+        return false;
+    }
+    return true;
+}
+
+static void cmd_speed(int argc, char **argv)
+{
+    (void)argc;
+    uint8_t value;
+
+    if (!parse_byte(argv[1], &value))
+    {
+        return;
+    }
+
+    // The UART to the module stays at 9600 8N1, another setting would cut it off
+    uint8_t parity = value & E32_SPEED_PARITY_MASK;
+    if ((value & E32_SPEED_BAUD_MASK) != E32_SPEED_BAUD_9600 || (parity != 0x00 && parity != E32_SPEED_PARITY_MASK))
+    {
+        printf("speed must keep 9600 8N1, %02X to %02X\n", E32_SPEED_BAUD_9600, E32_SPEED_BAUD_9600 | 0x07);
+        return;
+    }
+    edit.config[3] = value;
+}
+
+static void cmd_chan(int argc, char **argv)
+{
+    (void)argc;
+    uint8_t value;
+
+    if (parse_channel(argv[1], &value))
+    {
+        edit.config[4] = value;
+    }
+}
+
+static void cmd_option(int argc, char **argv)
+{
+    (void)argc;
+    uint8_t value;
+
+    if (!parse_byte(argv[1], &value))
+    {
+        return;
+    }
+
+    // Frames are sent with the 3 byte address header of fixed transmission
+    if (!(value & E32_OPTION_FIXED))
+    {
+        printf("option must keep fixed transmission (bit 7)\n");
+        return;
+    }
+    edit.config[5] = value;
+}
+
+static void cmd_peer(int argc, char **argv)
+{
+    char *end;
+    long n = strtol(argv[1], &end, 10);
+    uint8_t addh, addl, chan;
+
+    if (end == argv[1] || *end != '\0' || n < 0 || n >= NODE_STORE_PEERS)
+    {
+        printf("peer is 0 to %d\n", NODE_STORE_PEERS - 1);
+        return;
+    }
+
+    if (!parse_byte(argv[2], &addh) || !parse_byte(argv[3], &addl) || !parse_channel(argv[4], &chan))
+    {
+        return;
+    }
+
+    node_peer_t *p = &edit.peers[n];
+    p->addh = addh;
+    p->addl = addl;
+    p->chan = chan;
+    if (argc > 5)
+    {
+        strncpy(p->msg, argv[5], sizeof(p->msg) - 1);
+        p->msg[sizeof(p->msg) - 1] = '\0';
+    }
+}
+
+static void cmd_save(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    if (!hooks->save(&edit))
+    {
+        printf("flash write failed\n");
+    }
+    edit = *live;
+}
+
+static void cmd_reset(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    hooks->reset();
+    edit = *live;
+}
+
+static void cmd_stats(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    telemetry_print();
+}
+
+static void cmd_trace(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    trace_dump();
+}
+
+static void cmd_bench(int argc, char **argv)
+{
+    uint32_t n, count, interval_ms, size;
+
+    if (argc == 1)
+    {
+        bench_print();
+        return;
+    }
+    if (argc == 2 && strcmp(argv[1], "stop") == 0)
+    {
+        bench_stop();
+        return;
+    }
+    if (argc != 5)
+    {
+        printf("usage: bench [N COUNT MS SIZE | stop]\n");
+        return;
+    }
+
+    if (!parse_number(argv[1], &n) || !parse_number(argv[2], &count) || !parse_number(argv[3], &interval_ms) ||
+        !parse_number(argv[4], &size))
+    {
+        return;
+    }
+    if (n >= NODE_STORE_PEERS)
+    {
+        printf("peer is 0 to %d\n", NODE_STORE_PEERS - 1);
+        return;
+    }
+
+    const node_peer_t *p = &live->peers[n];
+    if (!bench_start(p->addh, p->addl, p->chan, count, interval_ms, size))
+    {
+        printf("count is 1 to %d, size %d to %d bytes\n", BENCH_MAX_PROBES, BENCH_HEADER_LEN, FRAME_MAX_PAYLOAD);
+    }
+}
+
+static void cmd_link(int argc, char **argv)
+{
+    if (argc == 2 && (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0))
+    {
+        link_enable(strcmp(argv[1], "on") == 0);
+    }
+    else if (argc != 1)
+    {
+        printf("usage: link [on|off]\n");
+        return;
+    }
+
+    link_print();
+}
+
+static void cmd_help(int argc, char **argv);
+
+static const command_t commands[] = {
+    { "show", "", "settings in use, being edited, read from the module before the last write", 0, cmd_show },
+    { "addr", "HH LL", "own address", 2, cmd_addr },
+    { "chan", "CC", "own channel", 1, cmd_chan },
+    { "speed", "SS", "speed byte (UART baud, parity, air rate)", 1, cmd_speed },
+    { "option", "OO", "option byte (fixed transmission, power)", 1, cmd_option },
+    { "peer", "N HH LL CC [text]", "destination and message of button N", 4, cmd_peer },
+    { "save", "", "store in flash, configure the module if it differs", 0, cmd_save },
+    { "reset", "", "erase the stored settings, use the built in ones", 0, cmd_reset },
+    { "stats", "", "counters of the radio, frames, queues, display and power", 0, cmd_stats },
+    { "trace", "", "dump the recorded events for trace2json, LORA_TRACE builds", 0, cmd_trace },
+    { "bench", "[N COUNT MS SIZE]", "probe the destination of button N, 0 ms = back to back; results", 0, cmd_bench },
+    { "link", "[on|off]", "step the air rate with the link quality; state and counters", 0, cmd_link },
+    { "help", "", "this list", 0, cmd_help },
+};
+
+#define N_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+static void cmd_help(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    for (size_t i = 0; i < N_COMMANDS; i++)
+    {
+        printf("%-7s %-18s %s\n", commands[i].name, commands[i].args, commands[i].help);
+    }
+}
+
+// Splits a line at spaces, the last word gets the rest of the line
+static int split(char *text, char **argv)
+{
+    int argc = 0;
+
+    while (*text && argc < MAX_ARGS)
+    {
+        while (*text == ' ')
+        {
+            text++;
+        }
+        if (!*text)
+        {
+            break;
+        }
+
+        argv[argc++] = text;
+        if (argc == MAX_ARGS)
+        {
+            break;
+        }
+
+        while (*text && *text != ' ')
+        {
+            text++;
+        }
+        if (*text)
+        {
+            *text++ = '\0';
+        }
+    }
+    return argc;
+}
+
+static void run_line(char *text)
+{
+    char *argv[MAX_ARGS];
+    int argc = split(text, argv);
+
+    if (argc == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < N_COMMANDS; i++)
+    {
+        if (strcmp(argv[0], commands[i].name) == 0)
+        {
+            if (argc - 1 < commands[i].min_args)
+            {
+                printf("usage: %s %s\n", commands[i].name, commands[i].args);
+                return;
+            }
+            commands[i].run(argc, argv);
+            return;
+        }
+    }
+    printf("unknown command %s, try help\n", argv[0]);
+}
+
+void console_init(const node_settings_t *live_settings, const console_hooks_t *console_hooks)
+{
+    live = live_settings;
+    hooks = console_hooks;
+    edit = *live;
+}
+
+void console_poll()
+{
+    int c;
+
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+    {
+        if (c == '\r' || c == '\n')
+        {
+            line[line_len] = '\0';
+            if (line_overflow)
+            {
+                printf("line too long\n");
+            }
+            else
+            {
+                run_line(line);
+            }
+            line_len = 0;
+            line_overflow = false;
+        }
+        else if (line_len < sizeof(line) - 1)
+        {
+            line[line_len++] = (char)c;
+        }
+        else
+        {
+            line_overflow = true;
+        }
+    }
+}
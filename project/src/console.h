@@ -0,0 +1,30 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdbool.h>
+
+#include "node_store.h"
+
+// Longest command line, longer lines are dropped
+#define CONSOLE_LINE_MAX 80
+
+typedef struct
+{
+    // Stores the edited settings in flash and applies them, returns false if the flash write failed
+    bool (*save)(const node_settings_t *settings);
+
+    // Erases the stored settings and goes back to the built in ones
+    void (*reset)(void);
+} console_hooks_t;
+
+/**
+*   @brief Starts the command console on the USB serial port
+*   @param live Settings in use, edits are made on a copy until save
+*   @param hooks Called by the save and reset commands
+*/
+void console_init(const node_settings_t *live, const console_hooks_t *hooks);
+
+// Reads what arrived on the serial port and runs complete lines, never blocks
+void console_poll(void);
+
+#endif
@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "e32.h"
+#include "e32_uart.h"
+#include "trace.h"
+
+typedef enum
+{
+    CFG_IDLE,
+    CFG_WAIT_MODE,  // Waiting for the mode switch to complete
+    CFG_QUERY,      // Send 3x READ_CONFIG
+    CFG_WAIT_QUERY,
+    CFG_WRITE,      // Send the wanted configuration
+    CFG_WAIT_ECHO,
+    CFG_DONE,
+    CFG_FAILED
+} cfg_step_t;
+
+static uart_inst_t *e32_uart_id;
+static uint e32_m0_pin, e32_m1_pin, e32_aux_pin;
+
+// AUX state, written by the GPIO interrupt
+static volatile bool aux_high = false;
+static volatile uint32_t aux_rise_us = 0;
+static volatile uint32_t aux_edges = 0;
+static volatile uint32_t aux_rises = 0;
+
+static struct
+{
+    int mode;
+    bool switching;
+    e32_mode_status_t status;
+    uint32_t switch_us;
+    uint32_t edges_at_switch;
+    uint32_t deadline;
+    e32_mode_cb_t done;
+    void *user_data;
+} mode_sw;
+
+static struct
+{
+    cfg_step_t step;
+    cfg_step_t after_mode;
+    uint8_t wanted[E32_CONFIG_LEN];
+    uint8_t current[E32_CONFIG_LEN];
+    uint8_t reply[E32_CONFIG_LEN];
+    size_t reply_len;
+    uint32_t deadline;
+    uint8_t attempts;
+    e32_error_t error;
+    bool written;
+    bool temporary; // A TEMP_CONFIG write is in effect, the C1 reply no longer shows what the EEPROM holds
+} cfg;
+
+static bool deadline_passed(uint32_t deadline)
+{
+    return (int32_t)(time_us_32() - deadline) >= 0;
+}
+
+static void print_config(const char *what, const uint8_t *config)
+{
+    printf("%s: ", what);
+    for (int i = 0; i < E32_CONFIG_LEN; i++)
+    {
+        printf("0x%02X ", config[i]);
+    }
+    printf("\n");
+}
+
+static void switch_mode(int mode, cfg_step_t next)
+{
+    e32_change_mode(mode, NULL, NULL);
+    cfg.after_mode = next;
+    cfg.step = CFG_WAIT_MODE;
+}
+
+static void send_and_expect_reply(const uint8_t *data, size_t len, cfg_step_t wait_step)
+{
+    // Anything left over from before the command would be taken as its reply
+    e32_uart_discard();
+    uart_write_blocking(e32_uart_id, data, len);
+
+    cfg.reply_len = 0;
+    cfg.deadline = time_us_32() + E32_REPLY_TIMEOUT_MS * 1000;
+    cfg.step = wait_step;
+}
+
+// Collects the 6 byte reply, returns true once it is complete
+static bool read_reply()
+{
+    cfg.reply_len += e32_uart_read(cfg.reply + cfg.reply_len, E32_CONFIG_LEN - cfg.reply_len);
+    return cfg.reply_len == E32_CONFIG_LEN;
+}
+
+static void fail(e32_error_t err)
+{
+    cfg.error = err;
+    cfg.step = CFG_FAILED;
+    e32_change_mode(NORMAL_MODE, NULL, NULL);
+    printf("[e32] configuration failed: %s\n", e32_error_str(err));
+}
+
+// Retries the command of retry_step or gives up with err
+static void retry_or_fail(cfg_step_t retry_step, e32_error_t err)
+{
+    if (++cfg.attempts < E32_CONFIG_ATTEMPTS)
+    {
+        cfg.step = retry_step;
+    }
+    else
+    {
+        fail(err);
+    }
+}
+
+void e32_init(uart_inst_t *uart, uint m0_pin, uint m1_pin, uint aux_pin)
+{
+    e32_uart_id = uart;
+    e32_m0_pin = m0_pin;
+    e32_m1_pin = m1_pin;
+    e32_aux_pin = aux_pin;
+
+    gpio_init(m0_pin);
+    gpio_set_dir(m0_pin, GPIO_OUT);
+    gpio_init(m1_pin);
+    gpio_set_dir(m1_pin, GPIO_OUT);
+
+    // AUX pin on the module is an output pin so we set GPIO as input.
+    // Pulled down so a missing module reads as never ready.
+    gpio_init(aux_pin);
+    gpio_set_dir(aux_pin, GPIO_IN);
+    gpio_pull_down(aux_pin);
+    aux_high = gpio_get(aux_pin);
+    gpio_set_irq_enabled(aux_pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+
+    mode_sw.mode = NORMAL_MODE;
+    mode_sw.switching = false;
+    mode_sw.status = E32_MODE_READY;
+    cfg.step = CFG_IDLE;
+}
+
+void e32_aux_irq(uint32_t events)
+{
+    // Both edges may be pending at once, the pin level decides
+    bool high = gpio_get(e32_aux_pin);
+
+    if (high && ((events & GPIO_IRQ_EDGE_RISE) || !aux_high))
+    {
+        aux_rise_us = time_us_32();
+        aux_rises++;
+    }
+    aux_high = high;
+    aux_edges++;
+    TRACE(TRACE_AUX, high);
+}
+
+void e32_set_mode_pins(int mode)
+{
+    switch (mode)
+    {
+    case NORMAL_MODE:
+        gpio_put(e32_m0_pin, 0);
+        gpio_put(e32_m1_pin, 0);
+        break;
+    case WAKEUP_MODE:
+        gpio_put(e32_m0_pin, 1);
+        gpio_put(e32_m1_pin, 0);
+        break;
+    case POWERSAVING_MODE:
+        gpio_put(e32_m0_pin, 0);
+        gpio_put(e32_m1_pin, 1);
+        break;
+    case SLEEP_MODE:
+        gpio_put(e32_m0_pin, 1);
+        gpio_put(e32_m1_pin, 1);
+        break;
+    default:
+        // Invalid mode, do nothing
+        break;
+    }
+}
+
+bool e32_aux_ready()
+{
+    return aux_high;
+}
+
+uint32_t e32_aux_rise_count()
+{
+    return aux_rises;
+}
+
+static void finish_mode_switch(e32_mode_status_t status)
+{
+    e32_mode_cb_t done = mode_sw.done;
+
+    mode_sw.switching = false;
+    mode_sw.status = status;
+    mode_sw.done = NULL;
+    TRACE(TRACE_MODE_END, status == E32_MODE_READY);
+
+    if (done)
+    {
+        done(mode_sw.mode, status == E32_MODE_READY, mode_sw.user_data);
+    }
+}
+
+void e32_change_mode(int mode, e32_mode_cb_t done, void *user_data)
+{
+    if (mode_sw.switching)
+    {
+        finish_mode_switch(E32_MODE_TIMEOUT);
+    }
+
+    TRACE(TRACE_MODE_BEGIN, mode);
+    mode_sw.edges_at_switch = aux_edges;
+    mode_sw.switch_us = time_us_32();
+    mode_sw.deadline = mode_sw.switch_us + E32_AUX_TIMEOUT_MS * 1000;
+    mode_sw.mode = mode;
+    mode_sw.done = done;
+    mode_sw.user_data = user_data;
+    mode_sw.status = E32_MODE_SWITCHING;
+    mode_sw.switching = true;
+
+    e32_set_mode_pins(mode);
+}
+
+e32_mode_status_t e32_mode_poll()
+{
+    if (!mode_sw.switching)
+    {
+        return mode_sw.status;
+    }
+
+    // Settle time counts from the rising edge that ended the switch, or from
+    // the switch itself if the module never pulled AUX low
+    if (aux_high)
+    {
+        uint32_t since = aux_edges != mode_sw.edges_at_switch ? aux_rise_us : mode_sw.switch_us;
+        if (time_us_32() - since >= E32_AUX_SETTLE_US)
+        {
+            finish_mode_switch(E32_MODE_READY);
+            return mode_sw.status;
+        }
+    }
+
+    if (deadline_passed(mode_sw.deadline))
+    {
+        finish_mode_switch(E32_MODE_TIMEOUT);
+    }
+    return mode_sw.status;
+}
+
+int e32_mode()
+{
+    return mode_sw.mode;
+}
+
+bool e32_config_start(const uint8_t config[E32_CONFIG_LEN])
+{
+    if (e32_config_poll() == E32_CONFIG_BUSY)
+    {
+        return false;
+    }
+
+    memcpy(cfg.wanted, config, E32_CONFIG_LEN);
+    cfg.attempts = 0;
+    cfg.error = E32_OK;
+    cfg.written = false;
+
+    switch_mode(SLEEP_MODE, CFG_QUERY);
+    return true;
+}
+
+e32_config_status_t e32_config_poll()
+{
+    static const uint8_t query[] = { READ_CONFIG, READ_CONFIG, READ_CONFIG };
+
+    switch (cfg.step)
+    {
+    case CFG_IDLE:
+    case CFG_DONE:
+        return E32_CONFIG_DONE;
+
+    case CFG_FAILED:
+        return E32_CONFIG_FAILED;
+
+    case CFG_WAIT_MODE:
+        switch (e32_mode_poll())
+        {
+        case E32_MODE_READY:
+            cfg.step = cfg.after_mode;
+            break;
+        case E32_MODE_TIMEOUT:
+            fail(E32_ERR_AUX_TIMEOUT);
+            break;
+        default:
+            break;
+        }
+        break;
+
+    case CFG_QUERY:
+        send_and_expect_reply(query, sizeof(query), CFG_WAIT_QUERY);
+        break;
+
+    case CFG_WAIT_QUERY:
+        if (read_reply())
+        {
+            memcpy(cfg.current, cfg.reply, E32_CONFIG_LEN);
+            print_config("current config", cfg.current);
+            cfg.attempts = 0;
+
+            // Parameters already in effect, writing them again only costs time and EEPROM wear.
+            // Over a temporary configuration a SAVE_CONFIG is still written, the EEPROM may differ.
+            if (memcmp(cfg.current + 1, cfg.wanted + 1, E32_CONFIG_LEN - 1) == 0 &&
+                !(cfg.temporary && cfg.wanted[0] == SAVE_CONFIG))
+            {
+                printf("[e32] configuration unchanged, not written\n");
+                switch_mode(NORMAL_MODE, CFG_DONE);
+            }
+            else
+            {
+                cfg.step = CFG_WRITE;
+            }
+        }
+        else if (deadline_passed(cfg.deadline))
+        {
+            retry_or_fail(CFG_QUERY, E32_ERR_NO_REPLY);
+        }
+        break;
+
+    case CFG_WRITE:
+        send_and_expect_reply(cfg.wanted, E32_CONFIG_LEN, CFG_WAIT_ECHO);
+        break;
+
+    case CFG_WAIT_ECHO:
+        if (read_reply())
+        {
+            print_config("written config", cfg.reply);
+
+            // Only the parameters are compared, the header depends on SAVE_CONFIG/TEMP_CONFIG
+            if (memcmp(cfg.reply + 1, cfg.wanted + 1, E32_CONFIG_LEN - 1) == 0)
+            {
+                cfg.written = true;
+                cfg.temporary = cfg.wanted[0] == TEMP_CONFIG;
+                switch_mode(NORMAL_MODE, CFG_DONE);
+            }
+            else
+            {
+                retry_or_fail(CFG_WRITE, E32_ERR_MISMATCH);
+            }
+        }
+        else if (deadline_passed(cfg.deadline))
+        {
+            retry_or_fail(CFG_WRITE, E32_ERR_NO_REPLY);
+        }
+        break;
+    }
+
+    if (cfg.step == CFG_DONE)
+    {
+        return E32_CONFIG_DONE;
+    }
+    return cfg.step == CFG_FAILED ? E32_CONFIG_FAILED : E32_CONFIG_BUSY;
+}
+
+// From the READ_CONFIG query to the echo, the mode switches around them leave the UART alone
+bool e32_config_reading()
+{
+    return cfg.step == CFG_QUERY || cfg.step == CFG_WAIT_QUERY || cfg.step == CFG_WRITE || cfg.step == CFG_WAIT_ECHO;
+}
+
+e32_error_t e32_config_error()
+{
+    return cfg.error;
+}
+
+const char *e32_error_str(e32_error_t err)
+{
+    switch (err)
+    {
+    case E32_OK:
+        return "ok";
+    case E32_ERR_AUX_TIMEOUT:
+        return "module not ready (AUX stuck low), check wiring and power";
+    case E32_ERR_NO_REPLY:
+        return "module did not reply";
+    case E32_ERR_MISMATCH:
+        return "module echoed a different configuration";
+    }
+    return "unknown error";
+}
+
+const uint8_t *e32_config_current()
+{
+    return cfg.current;
+}
+
+bool e32_config_written()
+{
+    return cfg.written;
+}
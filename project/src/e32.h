@@ -0,0 +1,158 @@
+#ifndef E32_H
+#define E32_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+
+// Command bytes understood by the module in SLEEP_MODE
+#define SAVE_CONFIG 0xC0 // Save configurations even after module power down
+#define READ_CONFIG 0xC1 // Sent three times, module answers with its 6 configuration bytes
+#define TEMP_CONFIG 0xC2 // Configurations are lost on power down
+#define READ_VERSION 0xC3
+#define RESET_MODULE 0xC4
+
+// Define module modes
+#define NORMAL_MODE 0
+#define WAKEUP_MODE 1
+#define POWERSAVING_MODE 2
+#define SLEEP_MODE 3
+
+// Configuration frame: { header, high address, low address, speed, channel, options }
+#define E32_CONFIG_LEN 6
+
+// Speed byte: parity (00 and 11 are 8N1), UART baud (011 = 9600), air rate in the low 3 bits
+#define E32_SPEED_PARITY_MASK 0xC0
+#define E32_SPEED_BAUD_MASK 0x38
+#define E32_SPEED_BAUD_9600 0x18
+
+// Option byte: fixed transmission, the first 3 bytes of a packet are the destination address and channel
+#define E32_OPTION_FIXED 0x80
+
+// Highest channel byte, 410 + CHAN MHz on the 433 MHz modules, other bands have other ranges
+#ifndef E32_CHANNEL_MAX
+#define E32_CHANNEL_MAX 0x1F
+#endif
+
+// Module transmit buffer and the largest packet it sends in one go
+#define E32_BUFFER_SIZE 512
+#define E32_SUBPACKET_SIZE 58
+
+// Module needs 2ms after AUX goes high before the new mode is in effect
+#define E32_AUX_SETTLE_US 2000
+#define E32_AUX_TIMEOUT_MS 1000
+#define E32_REPLY_TIMEOUT_MS 50
+#define E32_CONFIG_ATTEMPTS 3
+
+typedef enum
+{
+    E32_MODE_READY,     // Module reported ready in the requested mode
+    E32_MODE_SWITCHING, // Waiting for AUX
+    E32_MODE_TIMEOUT    // AUX did not signal ready within E32_AUX_TIMEOUT_MS
+} e32_mode_status_t;
+
+/**
+*   @brief Called when a mode switch started with e32_change_mode finished
+*   @param mode Mode that was requested
+*   @param ok false if the switch timed out or was replaced by another one
+*   @param user_data Pointer given to e32_change_mode
+*/
+typedef void (*e32_mode_cb_t)(int mode, bool ok, void *user_data);
+
+typedef enum
+{
+    E32_CONFIG_BUSY,
+    E32_CONFIG_DONE,
+    E32_CONFIG_FAILED
+} e32_config_status_t;
+
+typedef enum
+{
+    E32_OK,
+    E32_ERR_AUX_TIMEOUT, // AUX never signalled ready, module missing or unpowered
+    E32_ERR_NO_REPLY,    // Module did not answer within E32_REPLY_TIMEOUT_MS
+    E32_ERR_MISMATCH     // Echoed configuration differs from the one written
+} e32_error_t;
+
+/**
+*   @brief Sets up the mode and AUX pins of the EBYTE module
+*   @param uart UART connected to the module, replies are read through e32_uart
+*   @param m0_pin GPIO driving M0
+*   @param m1_pin GPIO driving M1
+*   @param aux_pin GPIO reading AUX
+*
+*   Enables both edge interrupts on aux_pin, the GPIO callback of the
+*   application has to pass them on to e32_aux_irq.
+*/
+void e32_init(uart_inst_t *uart, uint m0_pin, uint m1_pin, uint aux_pin);
+
+/**
+*   @brief Tracks the AUX level, call from the GPIO interrupt callback for the AUX pin
+*   @param events Edge events reported for the pin
+*/
+void e32_aux_irq(uint32_t events);
+
+/**
+*   @brief Drives M0/M1 for the given mode, does not wait for the module
+*   @param mode NORMAL_MODE, WAKEUP_MODE, POWERSAVING_MODE or SLEEP_MODE
+*/
+void e32_set_mode_pins(int mode);
+
+// AUX high = module idle and its buffer is empty, as last seen by the AUX interrupt
+bool e32_aux_ready(void);
+
+// Number of AUX rising edges so far, changes whenever the module emptied its buffer
+uint32_t e32_aux_rise_count(void);
+
+/**
+*   @brief Starts switching the module to another mode
+*   @param mode NORMAL_MODE, WAKEUP_MODE, POWERSAVING_MODE or SLEEP_MODE
+*   @param done Called from e32_mode_poll once the module is ready, may be NULL
+*   @param user_data Passed to done
+*
+*   The switch is complete E32_AUX_SETTLE_US after AUX rises again. A switch
+*   still in progress is replaced, its callback is called with ok=false.
+*/
+void e32_change_mode(int mode, e32_mode_cb_t done, void *user_data);
+
+// Advances a pending mode switch, call from the main loop
+e32_mode_status_t e32_mode_poll(void);
+
+// Mode the module was last switched to
+int e32_mode(void);
+
+/**
+*   @brief Starts writing a configuration to the module
+*   @param config Configuration frame, header SAVE_CONFIG or TEMP_CONFIG
+*   @return false if a configuration is already in progress
+*
+*   The module is put in SLEEP_MODE, its current configuration is read back,
+*   the new one is written and its echo compared, then NORMAL_MODE is restored.
+*   Nothing is written if the module already runs with the same parameters,
+*   unless a SAVE_CONFIG follows a TEMP_CONFIG: the module then reports the
+*   temporary parameters while the EEPROM still holds the older ones.
+*   Every step waits on AUX or on a bounded reply deadline, never on fixed sleeps.
+*/
+bool e32_config_start(const uint8_t config[E32_CONFIG_LEN]);
+
+// Advances the configuration, call until it stops returning E32_CONFIG_BUSY
+e32_config_status_t e32_config_poll(void);
+
+// The configuration is exchanging commands and replies, received bytes must be left to it
+bool e32_config_reading(void);
+
+// Reason of the last E32_CONFIG_FAILED
+e32_error_t e32_config_error(void);
+
+// Human readable text for an error
+const char *e32_error_str(e32_error_t err);
+
+// Configuration the module reported before it was written
+const uint8_t *e32_config_current(void);
+
+// false if the last configuration was already in effect and not written
+bool e32_config_written(void);
+
+#endif
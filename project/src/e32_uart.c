@@ -0,0 +1,185 @@
+#include "e32_uart.h"
+#include "trace.h"
+
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#define RX_RING_MASK (E32_RX_RING_SIZE - 1)
+
+_Static_assert((E32_RX_RING_SIZE & RX_RING_MASK) == 0, "E32_RX_RING_SIZE must be a power of two");
+
+static uart_inst_t *e32_uart;
+
+// Free running indices, head is only written by the interrupt and tail only by the main loop
+static uint8_t rx_ring[E32_RX_RING_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+static volatile e32_uart_stats_t uart_stats;
+
+// Rest of the buffer given to e32_uart_tx_start
+static const uint8_t *volatile tx_data;
+static volatile size_t tx_len = 0;
+
+// Writes as much of the pending buffer as fits into the TX FIFO
+static void tx_fill()
+{
+    while (tx_len && uart_is_writable(e32_uart))
+    {
+        uart_putc_raw(e32_uart, (char)*tx_data++);
+        tx_len--;
+        uart_stats.tx_bytes++;
+    }
+}
+
+// Drains the hardware RX FIFO into the ring, from the interrupt or with interrupts off
+static void rx_drain()
+{
+    uart_hw_t *hw = uart_get_hw(e32_uart);
+    uint32_t head = rx_head;
+
+    while (uart_is_readable(e32_uart))
+    {
+        uint8_t c = (uint8_t)uart_getc(e32_uart);
+
+        // Error flags of the byte just read, writing the register clears them
+        uint32_t rsr = hw->rsr;
+        if (rsr)
+        {
+            if (rsr & UART_UARTRSR_OE_BITS)
+            {
+                uart_stats.fifo_overruns++;
+            }
+            if (rsr & (UART_UARTRSR_BE_BITS | UART_UARTRSR_PE_BITS | UART_UARTRSR_FE_BITS))
+            {
+                uart_stats.line_errors++;
+            }
+            hw->rsr = 0;
+        }
+
+        if (head - rx_tail == E32_RX_RING_SIZE)
+        {
+            uart_stats.ring_overruns++;
+            continue;
+        }
+
+        rx_ring[head & RX_RING_MASK] = c;
+        head++;
+        uart_stats.rx_bytes++;
+    }
+
+    if (head != rx_head)
+    {
+        TRACE(TRACE_UART_RX, head - rx_head);
+    }
+
+    // Publish the data before the new head
+    __dmb();
+    rx_head = head;
+}
+
+// Drains the hardware RX FIFO into the ring and refills the TX FIFO
+static void e32_uart_irq()
+{
+    if (tx_len)
+    {
+        tx_fill();
+        if (!tx_len)
+        {
+            uart_set_irq_enables(e32_uart, true, false);
+        }
+    }
+
+    rx_drain();
+}
+
+void e32_uart_init(uart_inst_t *uart)
+{
+    e32_uart = uart;
+
+    int irq = uart_get_index(uart) == 0 ? UART0_IRQ : UART1_IRQ;
+    irq_set_exclusive_handler(irq, e32_uart_irq);
+    irq_set_enabled(irq, true);
+
+    // Interrupt on RX data and on RX timeout, TX only while a buffer is pending
+    uart_set_irq_enables(uart, true, false);
+}
+
+bool e32_uart_tx_start(const uint8_t *data, size_t len)
+{
+    if (tx_len)
+    {
+        return false;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+
+    tx_data = data;
+    tx_len = len;
+
+    // The TX interrupt only fires when the FIFO level drops below its threshold,
+    // so it is primed here and only enabled if the buffer does not fit
+    tx_fill();
+    if (tx_len)
+    {
+        uart_set_irq_enables(e32_uart, true, true);
+    }
+
+    restore_interrupts(irq);
+    return true;
+}
+
+bool e32_uart_tx_busy()
+{
+    return tx_len != 0;
+}
+
+bool e32_uart_tx_idle()
+{
+    return tx_len == 0 && !(uart_get_hw(e32_uart)->fr & UART_UARTFR_BUSY_BITS);
+}
+
+size_t e32_uart_available()
+{
+    return rx_head - rx_tail;
+}
+
+size_t e32_uart_read(uint8_t *dst, size_t max)
+{
+    uint32_t tail = rx_tail;
+    uint32_t avail = rx_head - tail;
+    size_t n = avail < max ? avail : max;
+
+    // Read the data only after seeing the head that published it
+    __dmb();
+    for (size_t i = 0; i < n; i++)
+    {
+        dst[i] = rx_ring[(tail + i) & RX_RING_MASK];
+    }
+
+    __dmb();
+    rx_tail = tail + n;
+    return n;
+}
+
+size_t e32_uart_discard()
+{
+    // Bytes still in the hardware FIFO go as well, with their errors counted
+    uint32_t irq = save_and_disable_interrupts();
+    rx_drain();
+    uint32_t head = rx_head;
+    size_t n = head - rx_tail;
+
+    rx_tail = head;
+    restore_interrupts(irq);
+    return n;
+}
+
+void e32_uart_get_stats(e32_uart_stats_t *stats)
+{
+    stats->rx_bytes = uart_stats.rx_bytes;
+    stats->tx_bytes = uart_stats.tx_bytes;
+    stats->ring_overruns = uart_stats.ring_overruns;
+    stats->fifo_overruns = uart_stats.fifo_overruns;
+    stats->line_errors = uart_stats.line_errors;
+}
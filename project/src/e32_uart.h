@@ -0,0 +1,66 @@
+#ifndef E32_UART_H
+#define E32_UART_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hardware/uart.h"
+
+// Size of the software receive ring, must be a power of two (~1 s of data at 9600 baud)
+#define E32_RX_RING_SIZE 1024
+
+// UART counters, updated from the UART interrupt
+typedef struct
+{
+    uint32_t rx_bytes;      // Bytes moved from the UART FIFO into the ring
+    uint32_t tx_bytes;      // Bytes written to the UART FIFO by e32_uart_tx_start
+    uint32_t ring_overruns; // Bytes dropped because the ring was full
+    uint32_t fifo_overruns; // Hardware FIFO overruns flagged by the UART
+    uint32_t line_errors;   // Bytes received with framing, parity or break errors
+} e32_uart_stats_t;
+
+/**
+*   @brief Installs the receive interrupt for the UART connected to the EBYTE module
+*   @param uart UART instance, already initialised with uart_init
+*
+*   From here on the interrupt drains the hardware FIFO into a single-producer/
+*   single-consumer ring, so the main loop only has to read from the ring.
+*   The same interrupt feeds the TX FIFO for e32_uart_tx_start.
+*/
+void e32_uart_init(uart_inst_t *uart);
+
+// Number of received bytes waiting in the ring
+size_t e32_uart_available(void);
+
+/**
+*   @brief Moves up to max bytes out of the ring
+*   @param dst Destination buffer
+*   @param max Size of dst
+*   @return Number of bytes copied
+*/
+size_t e32_uart_read(uint8_t *dst, size_t max);
+
+/**
+*   @brief Drops everything currently in the ring and the hardware RX FIFO
+*   @return Number of bytes discarded
+*/
+size_t e32_uart_discard(void);
+
+/**
+*   @brief Starts sending a buffer, the TX interrupt refills the FIFO until it is all written
+*   @param data Bytes to send, must stay valid until e32_uart_tx_busy returns false
+*   @param len Number of bytes
+*   @return false if the previous buffer is still being written
+*/
+bool e32_uart_tx_start(const uint8_t *data, size_t len);
+
+// True while bytes of the last e32_uart_tx_start are waiting for space in the FIFO
+bool e32_uart_tx_busy(void);
+
+// True once every byte has left the UART, FIFO and shift register included
+bool e32_uart_tx_idle(void);
+
+// Copies the UART counters
+void e32_uart_get_stats(e32_uart_stats_t *stats);
+
+#endif
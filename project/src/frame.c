@@ -0,0 +1,219 @@
+#include <string.h>
+
+#include "frame.h"
+#include "compress.h"
+#include "trace.h"
+
+uint16_t frame_crc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+size_t frame_encode(uint8_t *out, uint8_t flags, const uint8_t src[3], uint8_t seq, const uint8_t *payload, size_t len)
+{
+    if (len > FRAME_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+    out[0] = FRAME_SYNC0;
+    out[1] = FRAME_SYNC1;
+    out[2] = (uint8_t)len;
+    out[3] = flags;
+    out[4] = src[0];
+    out[5] = src[1];
+    out[6] = src[2];
+    out[7] = seq;
+    if (len)
+    {
+        memcpy(out + FRAME_HEADER_LEN, payload, len);
+    }
+
+    uint16_t crc = frame_crc16(out + 2, FRAME_HEADER_LEN - 2 + len);
+    out[FRAME_HEADER_LEN + len] = crc >> 8;
+    out[FRAME_HEADER_LEN + len + 1] = crc & 0xFF;
+
+    return FRAME_OVERHEAD + len;
+}
+
+bool frame_add_record(uint8_t *payload, size_t *used, const uint8_t *record, size_t len)
+{
+    if (*used + 1 + len > FRAME_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    payload[*used] = (uint8_t)len;
+    memcpy(payload + *used + 1, record, len);
+    *used += 1 + len;
+    return true;
+}
+
+bool frame_next_record(const frame_t *frame, size_t *offset, const uint8_t **record, size_t *len)
+{
+    if (*offset >= frame->len)
+    {
+        return false;
+    }
+
+    size_t rec_len = frame->payload[*offset];
+    if (*offset + 1 + rec_len > frame->len)
+    {
+        return false;
+    }
+
+    *record = frame->payload + *offset + 1;
+    *len = rec_len;
+    *offset += 1 + rec_len;
+    return true;
+}
+
+size_t frame_pack_payload(uint8_t codec, const uint8_t *raw, size_t len, uint8_t *out, uint8_t *flags)
+{
+    const codec_t *c = codec_get(codec);
+
+    if (c && len <= COMPRESS_MAX_RAW)
+    {
+        size_t n = c->encode(raw, len, out, FRAME_MAX_PAYLOAD);
+        if (n > 0 && n < len)
+        {
+            *flags |= codec << FRAME_CODEC_SHIFT;
+            return n;
+        }
+    }
+
+    if (len > FRAME_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+    memcpy(out, raw, len);
+    return len;
+}
+
+bool frame_unpack_payload(const frame_t *frame, uint8_t *out, size_t max, size_t *len)
+{
+    uint8_t codec = (frame->flags & FRAME_CODEC_MASK) >> FRAME_CODEC_SHIFT;
+
+    if (codec == CODEC_NONE)
+    {
+        if (frame->len > max)
+        {
+            return false;
+        }
+        memcpy(out, frame->payload, frame->len);
+        *len = frame->len;
+        return true;
+    }
+
+    const codec_t *c = codec_get(codec);
+    if (!c)
+    {
+        return false;
+    }
+
+    *len = c->decode(frame->payload, frame->len, out, max);
+    return *len > 0;
+}
+
+void frame_parser_init(frame_parser_t *p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+// Removes n bytes from the front of the buffer
+static void consume(frame_parser_t *p, size_t n)
+{
+    memmove(p->buf, p->buf + n, p->len - n);
+    p->len -= n;
+}
+
+// Drops the current start of frame and skips ahead to the next SYNC0, returns the bytes dropped
+static size_t resync(frame_parser_t *p)
+{
+    size_t i = 1;
+    while (i < p->len && p->buf[i] != FRAME_SYNC0)
+    {
+        i++;
+    }
+
+    p->stats.discarded += i;
+    consume(p, i);
+    return i;
+}
+
+// Checks the buffered bytes, reports every complete frame and resynchronises on errors
+static void process(frame_parser_t *p, frame_cb_t cb, void *user_data)
+{
+    while (p->len)
+    {
+        if (p->buf[0] != FRAME_SYNC0 || (p->len > 1 && p->buf[1] != FRAME_SYNC1))
+        {
+            resync(p);
+            continue;
+        }
+
+        if (p->len < 3)
+        {
+            return;
+        }
+
+        if (p->buf[2] > FRAME_MAX_PAYLOAD)
+        {
+            p->stats.bad_length++;
+            size_t dropped = resync(p);
+            TRACE(TRACE_FRAME_BAD, dropped);
+            continue;
+        }
+
+        size_t need = FRAME_OVERHEAD + p->buf[2];
+        if (p->len < need)
+        {
+            return;
+        }
+
+        size_t crc_at = FRAME_HEADER_LEN + p->buf[2];
+        uint16_t crc = frame_crc16(p->buf + 2, crc_at - 2);
+        if (p->buf[crc_at] != crc >> 8 || p->buf[crc_at + 1] != (crc & 0xFF))
+        {
+            p->stats.crc_errors++;
+            size_t dropped = resync(p);
+            TRACE(TRACE_FRAME_BAD, dropped);
+            continue;
+        }
+
+        frame_t frame = {
+            .flags = p->buf[3],
+            .src_high = p->buf[4],
+            .src_low = p->buf[5],
+            .src_channel = p->buf[6],
+            .seq = p->buf[7],
+            .len = p->buf[2],
+            .payload = p->buf + FRAME_HEADER_LEN,
+        };
+        p->stats.frames_ok++;
+        TRACE(TRACE_FRAME_OK, frame.seq);
+        cb(&frame, user_data);
+
+        consume(p, need);
+    }
+}
+
+void frame_parser_feed(frame_parser_t *p, const uint8_t *data, size_t len, frame_cb_t cb, void *user_data)
+{
+    // process() never leaves a complete frame in the buffer, so there is always room for one more byte
+    for (size_t i = 0; i < len; i++)
+    {
+        p->buf[p->len++] = data[i];
+        process(p, cb, user_data);
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tx_queue.h"
+
+/**
+*   Frame layout, sent after the 3 byte address header of fixed transmission:
+*   SYNC0 SYNC1 | length | flags | src addr high | src addr low | src channel | sequence | payload | CRC-16 high, low
+*   The CRC (CCITT, init 0xFFFF) covers length up to the end of the payload.
+*/
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define FRAME_HEADER_LEN 8
+#define FRAME_CRC_LEN 2
+#define FRAME_OVERHEAD (FRAME_HEADER_LEN + FRAME_CRC_LEN)
+#define FRAME_MAX_LEN TX_MAX_PAYLOAD
+#define FRAME_MAX_PAYLOAD (FRAME_MAX_LEN - FRAME_OVERHEAD)
+
+// Payload is a list of records, each prefixed with its length byte
+#define FRAME_FLAG_RECORDS 0x01
+// Sender waits for an acknowledgement of this sequence number, the payload starts with its session (reliable.h)
+#define FRAME_FLAG_ACK_REQ 0x02
+// Acknowledges the sequence number of a FRAME_FLAG_ACK_REQ frame, the payload is its session byte
+#define FRAME_FLAG_ACK 0x04
+// Benchmark probe or its echo, handled by bench.c
+#define FRAME_FLAG_PROBE 0x08
+// Air rate negotiation, handled by link.c
+#define FRAME_FLAG_LINK 0x40
+// Codec the payload is compressed with (CODEC_* in compress.h), 0 = uncompressed
+#define FRAME_CODEC_SHIFT 4
+#define FRAME_CODEC_MASK 0x30
+
+typedef struct
+{
+    uint8_t flags;
+    uint8_t src_high;
+    uint8_t src_low;
+    uint8_t src_channel;
+    uint8_t seq;
+    uint8_t len;
+    const uint8_t *payload; // Only valid inside the frame callback
+} frame_t;
+
+typedef struct
+{
+    uint32_t frames_ok;
+    uint32_t crc_errors;
+    uint32_t bad_length; // Length byte larger than FRAME_MAX_PAYLOAD
+    uint32_t discarded;  // Bytes skipped while looking for the next sync
+} frame_stats_t;
+
+typedef struct
+{
+    uint8_t buf[FRAME_MAX_LEN];
+    size_t len;
+    frame_stats_t stats;
+} frame_parser_t;
+
+typedef void (*frame_cb_t)(const frame_t *frame, void *user_data);
+
+// CRC-16/CCITT-FALSE
+uint16_t frame_crc16(const uint8_t *data, size_t len);
+
+/**
+*   @brief Builds a frame
+*   @param out Destination, at least FRAME_OVERHEAD + len bytes
+*   @param flags FRAME_FLAG_* bits
+*   @param src Own address high, address low and channel
+*   @param seq Sequence number
+*   @param payload Payload bytes
+*   @param len Payload length, at most FRAME_MAX_PAYLOAD
+*   @return Frame length, 0 if the payload is too long
+*/
+size_t frame_encode(uint8_t *out, uint8_t flags, const uint8_t src[3], uint8_t seq, const uint8_t *payload, size_t len);
+
+/**
+*   @brief Appends a record to a FRAME_FLAG_RECORDS payload
+*   @param payload Payload being built
+*   @param used Bytes of payload already used, updated
+*   @param record Record bytes
+*   @param len Record length
+*   @return false if the record does not fit into FRAME_MAX_PAYLOAD
+*/
+bool frame_add_record(uint8_t *payload, size_t *used, const uint8_t *record, size_t len);
+
+/**
+*   @brief Iterates over the records of a FRAME_FLAG_RECORDS payload
+*   @param frame Frame being read
+*   @param offset Start at 0, updated to the next record
+*   @param record Set to the record bytes
+*   @param len Set to the record length
+*   @return false when there are no more records or the last one is truncated
+*/
+bool frame_next_record(const frame_t *frame, size_t *offset, const uint8_t **record, size_t *len);
+
+/**
+*   @brief Prepares a payload, compressed if the codec makes it shorter
+*   @param codec CODEC_* id to try, CODEC_NONE to send as is
+*   @param raw Message bytes
+*   @param len Message length, at most COMPRESS_MAX_RAW when compressing
+*   @param out Payload, FRAME_MAX_PAYLOAD bytes
+*   @param flags Codec bits are added when the payload was compressed
+*   @return Payload length, 0 if the message does not fit into a frame
+*/
+size_t frame_pack_payload(uint8_t codec, const uint8_t *raw, size_t len, uint8_t *out, uint8_t *flags);
+
+/**
+*   @brief Restores the message of a received frame
+*   @param frame Received frame
+*   @param out Message, COMPRESS_MAX_RAW bytes are enough for every codec
+*   @param max Size of out
+*   @param len Set to the message length
+*   @return false if the codec is unknown or the payload is malformed
+*/
+bool frame_unpack_payload(const frame_t *frame, uint8_t *out, size_t max, size_t *len);
+
+void frame_parser_init(frame_parser_t *p);
+
+/**
+*   @brief Feeds received bytes to the parser
+*   @param p Parser
+*   @param data Received bytes
+*   @param len Number of bytes
+*   @param cb Called for every frame with a valid CRC
+*   @param user_data Passed to cb
+*
+*   Garbage, bad lengths and CRC failures drop the first buffered byte and
+*   the parser resynchronises on the next SYNC0 SYNC1 already in its buffer.
+*/
+void frame_parser_feed(frame_parser_t *p, const uint8_t *data, size_t len, frame_cb_t cb, void *user_data);
+
+#endif
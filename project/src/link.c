@@ -0,0 +1,515 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "link.h"
+#include "reliable.h"
+#include "tx_queue.h"
+
+#include "pico/stdlib.h"
+
+// First payload byte
+#define KIND_PROPOSE 1
+#define KIND_ACCEPT 2
+
+#define CONTROL_LEN 3
+
+// Nominal air data rate per rate step
+static const uint32_t AIR_BPS[] = { 300, 1200, 2400, 4800, 9600, 19200 };
+
+// Time a PROPOSE and its ACCEPT take at most, from queueing to the answer, per rate step
+static const uint32_t REPLY_MS[] = { 8000, 3000, 2000, 1500, 1200, 1000 };
+
+typedef enum
+{
+    NEG_IDLE,
+    NEG_PROPOSING, // Proposing on the current rate
+    NEG_PROBING    // Switched without an answer, proposing again on the new rate
+} neg_step_t;
+
+typedef struct
+{
+    neg_step_t step;
+    uint8_t to[3];
+    uint8_t rate;
+    uint8_t from_rate;
+    uint8_t id;
+    uint8_t tries;
+    bool accepted;
+    uint32_t deadline;
+} negotiation_t;
+
+static const link_hooks_t *hooks;
+static uint8_t self_addr[3];
+static uint8_t frame_seq = 0;
+static bool started = false;
+
+static link_stats_t stats;
+static negotiation_t neg;
+static uint8_t next_id = 1;
+static uint32_t last_heard_us;
+
+// Counters of stats.peer at the start of the current window
+static bool have_peer = false;
+static reliable_peer_stats_t window_start;
+static uint8_t clean_windows;
+
+// Rate left because of failures, not proposed again before held_until
+static int held_rate = -1;
+static uint32_t held_until;
+
+// Proposal of another node answered, switched once the ACCEPT is on the air
+static bool answer_pending = false;
+static uint8_t answer_rate;
+
+// Rate being written to the module, -1 when none
+static int switching_to = -1;
+
+static bool deadline_passed(uint32_t deadline)
+{
+    return (int32_t)(time_us_32() - deadline) >= 0;
+}
+
+static void send_control(const uint8_t to[3], uint8_t kind, uint8_t rate, uint8_t id)
+{
+    const uint8_t payload[CONTROL_LEN] = { kind, rate, id };
+    uint8_t frame[FRAME_OVERHEAD + CONTROL_LEN];
+
+    size_t len = frame_encode(frame, FRAME_FLAG_LINK, self_addr, frame_seq++, payload, sizeof(payload));
+    tx_queue_push(to[0], to[1], to[2], frame, len);
+}
+
+static void send_propose()
+{
+    send_control(neg.to, KIND_PROPOSE, neg.rate, neg.id);
+    neg.tries++;
+    neg.deadline = time_us_32() + REPLY_MS[stats.rate] * 1000;
+}
+
+// Another node exchanged frames with this one lately, it stays on the saved rate and would be cut off
+static bool others_active(const uint8_t peer[3])
+{
+    reliable_peer_stats_t list[RELIABLE_MAX_PEERS];
+    size_t n = reliable_get_peer_stats(list, RELIABLE_MAX_PEERS);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        // Frames to the own address never get an answer, they say nothing about other nodes
+        if (memcmp(list[i].addr, peer, 2) == 0 || memcmp(list[i].addr, self_addr, 2) == 0)
+        {
+            continue;
+        }
+        if (time_us_32() - list[i].last_use_us < LINK_SILENCE_MS * 1000)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Starts a new window, counted from what the peer has now
+static void restart_window()
+{
+    reliable_peer_stats_t list[RELIABLE_MAX_PEERS];
+    size_t n = reliable_get_peer_stats(list, RELIABLE_MAX_PEERS);
+
+    for (size_t i = 0; have_peer && i < n; i++)
+    {
+        if (memcmp(list[i].addr, stats.peer, 3) == 0)
+        {
+            window_start = list[i];
+            break;
+        }
+    }
+    clean_windows = 0;
+}
+
+// Starts writing the rate to the module, the caller makes sure nothing is being sent
+static bool switch_to(uint8_t rate)
+{
+    if (rate == stats.rate)
+    {
+        return true;
+    }
+
+    if (!hooks->start_air_rate(rate))
+    {
+        stats.config_errors++;
+        return false;
+    }
+    switching_to = rate;
+    return true;
+}
+
+// Follows the write started by switch_to, returns true while it is still going on
+static bool switch_busy()
+{
+    if (switching_to < 0)
+    {
+        return false;
+    }
+
+    e32_config_status_t status = hooks->poll_air_rate();
+    if (status == E32_CONFIG_BUSY)
+    {
+        return true;
+    }
+
+    uint8_t rate = (uint8_t)switching_to;
+    switching_to = -1;
+    if (status != E32_CONFIG_DONE)
+    {
+        stats.config_errors++;
+        return false;
+    }
+
+    // Answers take longer from now on, the timeouts would fire before them
+    if (rate < stats.rate)
+    {
+        reliable_scale_rtt(AIR_BPS[stats.rate], AIR_BPS[rate]);
+    }
+
+    printf("[link] air rate %lu -> %lu bps\n", (unsigned long)AIR_BPS[stats.rate], (unsigned long)AIR_BPS[rate]);
+    stats.rate = rate;
+    stats.switches++;
+    last_heard_us = time_us_32();
+    restart_window();
+    return false;
+}
+
+static void start_negotiation(uint8_t rate)
+{
+    neg = (negotiation_t){
+        .step = NEG_PROPOSING,
+        .to = { stats.peer[0], stats.peer[1], stats.peer[2] },
+        .rate = rate,
+        .from_rate = stats.rate,
+        .id = next_id++,
+    };
+    stats.proposals++;
+
+    printf("[link] proposing %lu bps to %02X%02X\n", (unsigned long)AIR_BPS[rate], neg.to[0], neg.to[1]);
+    send_propose();
+}
+
+static void negotiate()
+{
+    if (neg.accepted)
+    {
+        // The module must not be switched with frames in its buffer
+        if (!tx_queue_idle())
+        {
+            return;
+        }
+        switch_to(neg.rate);
+        neg.step = NEG_IDLE;
+        return;
+    }
+
+    if (!deadline_passed(neg.deadline))
+    {
+        return;
+    }
+    if (neg.tries < LINK_PROPOSE_TRIES)
+    {
+        send_propose();
+        return;
+    }
+    if (!tx_queue_idle())
+    {
+        return;
+    }
+
+    // The peer may have switched and only its ACCEPTs got lost, proposed again once on the new rate
+    if (neg.step == NEG_PROPOSING && switch_to(neg.rate))
+    {
+        neg.step = NEG_PROBING;
+        neg.tries = 0;
+        neg.deadline = time_us_32();
+        return;
+    }
+
+    // A return to the saved rate is made anyway, the peer gets there after the silence
+    uint8_t stay = neg.rate == stats.base_rate ? neg.rate : neg.from_rate;
+    switch_to(stay);
+    neg.step = NEG_IDLE;
+    stats.failures++;
+    if (neg.rate > neg.from_rate)
+    {
+        held_rate = neg.rate;
+        held_until = time_us_32() + LINK_HOLD_MS * 1000;
+    }
+    printf("[link] no answer from %02X%02X, staying at %lu bps\n", neg.to[0], neg.to[1],
+           (unsigned long)AIR_BPS[stay]);
+}
+
+// Looks at the acknowledged frames of the busiest destination once a window is complete
+static void decide()
+{
+    reliable_peer_stats_t list[RELIABLE_MAX_PEERS];
+    size_t n = reliable_get_peer_stats(list, RELIABLE_MAX_PEERS);
+    const reliable_peer_stats_t *cur = NULL;
+
+    for (size_t i = 0; have_peer && i < n; i++)
+    {
+        if (memcmp(list[i].addr, stats.peer, 3) == 0)
+        {
+            cur = &list[i];
+        }
+    }
+
+    // Peer forgotten or none yet, the one with the most frames is followed from now on
+    if (!cur)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            if (memcmp(list[i].addr, self_addr, 2) == 0)
+            {
+                continue;
+            }
+            if (!cur || list[i].delivered + list[i].lost > cur->delivered + cur->lost)
+            {
+                cur = &list[i];
+            }
+        }
+        if (cur)
+        {
+            have_peer = true;
+            memcpy(stats.peer, cur->addr, 3);
+            window_start = (reliable_peer_stats_t){ .addr = { cur->addr[0], cur->addr[1], cur->addr[2] } };
+            clean_windows = 0;
+        }
+        return;
+    }
+
+    // Entry reused for the same address, its counters started over
+    if (cur->delivered < window_start.delivered || cur->lost < window_start.lost ||
+        cur->retries < window_start.retries)
+    {
+        window_start = *cur;
+        return;
+    }
+
+    uint32_t lost = cur->lost - window_start.lost;
+    uint32_t retries = cur->retries - window_start.retries;
+    if (cur->delivered - window_start.delivered + lost < LINK_WINDOW)
+    {
+        return;
+    }
+    window_start = *cur;
+
+    uint32_t clean = retries < LINK_WINDOW ? LINK_WINDOW - retries : 0;
+    stats.max_records = (uint8_t)(clean * LINK_MAX_RECORDS / LINK_WINDOW);
+    if (stats.max_records == 0)
+    {
+        stats.max_records = 1;
+    }
+
+    // Only a link between two nodes can change its rate
+    if (others_active(stats.peer))
+    {
+        clean_windows = 0;
+        if (stats.rate != stats.base_rate)
+        {
+            start_negotiation(stats.base_rate);
+        }
+    }
+    else if (lost > 0 || retries * 100 >= LINK_WINDOW * LINK_DOWN_RETRY_PCT)
+    {
+        clean_windows = 0;
+        if (stats.rate > LINK_RATE_MIN)
+        {
+            held_rate = stats.rate;
+            held_until = time_us_32() + LINK_HOLD_MS * 1000;
+            start_negotiation(stats.rate - 1);
+        }
+    }
+    else if (retries * 100 <= LINK_WINDOW * LINK_UP_RETRY_PCT)
+    {
+        bool held = held_rate == stats.rate + 1 && !deadline_passed(held_until);
+        if (++clean_windows >= LINK_UP_WINDOWS && stats.rate < LINK_RATE_MAX && !held)
+        {
+            clean_windows = 0;
+            start_negotiation(stats.rate + 1);
+        }
+    }
+    else
+    {
+        clean_windows = 0;
+    }
+}
+
+void link_init(const uint8_t config[E32_CONFIG_LEN], const link_hooks_t *link_hooks)
+{
+    uint8_t rate = config[3] & 0x07;
+
+    hooks = link_hooks;
+    self_addr[0] = config[1];
+    self_addr[1] = config[2];
+    self_addr[2] = config[4];
+
+    if (!started)
+    {
+        stats.enabled = LORA_LINK_ADAPT;
+        started = true;
+    }
+
+    // The module runs the saved configuration again
+    stats.base_rate = rate > LINK_RATE_MAX ? LINK_RATE_MAX : rate;
+    stats.rate = stats.base_rate;
+    stats.max_records = LINK_MAX_RECORDS;
+    neg.step = NEG_IDLE;
+    answer_pending = false;
+    switching_to = -1;
+    have_peer = false;
+    held_rate = -1;
+    clean_windows = 0;
+    last_heard_us = time_us_32();
+}
+
+void link_enable(bool enable)
+{
+    stats.enabled = enable;
+    neg.step = NEG_IDLE;
+    answer_pending = false;
+
+    // link_poll returns to the saved rate
+    if (!enable)
+    {
+        stats.max_records = LINK_MAX_RECORDS;
+    }
+}
+
+void link_poll()
+{
+    if (switch_busy())
+    {
+        return;
+    }
+
+    // Switched off, back to the saved rate once a switch still going on is done
+    if (!stats.enabled)
+    {
+        if (stats.rate != stats.base_rate && tx_queue_idle())
+        {
+            switch_to(stats.base_rate);
+        }
+        return;
+    }
+
+    if (answer_pending)
+    {
+        if (tx_queue_idle())
+        {
+            answer_pending = false;
+            switch_to(answer_rate);
+        }
+        return;
+    }
+
+    if (neg.step != NEG_IDLE)
+    {
+        negotiate();
+        return;
+    }
+
+    // Whatever went wrong, both ends meet again at the saved rate
+    if (stats.rate != stats.base_rate && deadline_passed(last_heard_us + LINK_SILENCE_MS * 1000))
+    {
+        if (tx_queue_idle() && switch_to(stats.base_rate))
+        {
+            stats.fallbacks++;
+        }
+        return;
+    }
+
+    decide();
+}
+
+bool link_on_frame(const frame_t *frame)
+{
+    last_heard_us = time_us_32();
+
+    if (!(frame->flags & FRAME_FLAG_LINK))
+    {
+        return false;
+    }
+    if (frame->len < CONTROL_LEN || !stats.enabled)
+    {
+        return true;
+    }
+
+    const uint8_t src[3] = { frame->src_high, frame->src_low, frame->src_channel };
+    uint8_t kind = frame->payload[0];
+    uint8_t rate = frame->payload[1];
+    uint8_t id = frame->payload[2];
+
+    if (kind == KIND_PROPOSE && rate <= LINK_RATE_MAX)
+    {
+        // Left unanswered, the proposer stays where it is
+        if (rate != stats.base_rate && others_active(src))
+        {
+            return true;
+        }
+
+        // The proposal of the peer wins over an own one that has not switched yet
+        if (neg.step == NEG_PROPOSING)
+        {
+            neg.step = NEG_IDLE;
+        }
+
+        send_control(src, KIND_ACCEPT, rate, id);
+        stats.accepted++;
+        if (rate != stats.rate)
+        {
+            answer_pending = true;
+            answer_rate = rate;
+        }
+    }
+    else if (kind == KIND_ACCEPT && neg.step != NEG_IDLE && id == neg.id && src[0] == neg.to[0] && src[1] == neg.to[1])
+    {
+        neg.accepted = true;
+    }
+    return true;
+}
+
+bool link_next_deadline(uint32_t *deadline)
+{
+    if (answer_pending || switching_to >= 0)
+    {
+        *deadline = time_us_32();
+        return true;
+    }
+    if (neg.step != NEG_IDLE)
+    {
+        *deadline = neg.deadline;
+        return true;
+    }
+    return false;
+}
+
+size_t link_max_records()
+{
+    return stats.max_records;
+}
+
+void link_get_stats(link_stats_t *out)
+{
+    *out = stats;
+}
+
+void link_print()
+{
+    printf("[link] %s  rate %lu bps  saved %lu bps  peer %02X%02X chan %02X\n", stats.enabled ? "on" : "off",
+           (unsigned long)AIR_BPS[stats.rate], (unsigned long)AIR_BPS[stats.base_rate], stats.peer[0], stats.peer[1],
+           stats.peer[2]);
+    printf("[link] proposals %lu  accepted %lu  switches %lu  failures %lu  fallbacks %lu  config errors %lu  "
+           "records/frame %u\n",
+           (unsigned long)stats.proposals, (unsigned long)stats.accepted, (unsigned long)stats.switches,
+           (unsigned long)stats.failures, (unsigned long)stats.fallbacks, (unsigned long)stats.config_errors,
+           stats.max_records);
+    if (neg.step != NEG_IDLE)
+    {
+        printf("[link] proposing %lu bps to %02X%02X, try %u\n", (unsigned long)AIR_BPS[neg.rate], neg.to[0],
+               neg.to[1], neg.tries);
+    }
+}
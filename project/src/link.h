@@ -0,0 +1,122 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+#include "e32.h"
+
+/**
+*   Adaptive air rate, switched on with the link console command or LORA_LINK_ADAPT.
+*
+*   The controller watches the acknowledged frames sent to the busiest
+*   destination. A window with a lost frame or many retransmissions steps the
+*   air rate down, LINK_UP_WINDOWS clean windows in a row step it up. Some
+*   retransmissions are allowed in a clean window, a half duplex channel
+*   loses frames to traffic at any rate. Both
+*   modules have to use the same air rate, so every step is negotiated:
+*
+*   - The node sends PROPOSE(rate) to the peer until it answers ACCEPT. The
+*     peer switches once its ACCEPT went out, the node once it got it.
+*   - Without an answer the node switches anyway and proposes again on the new
+*     rate, in case only the ACCEPTs were lost, and goes back if still nothing.
+*   - A node away from the saved rate that hears nothing for LINK_SILENCE_MS
+*     returns to it, the rate both ends meet at after any failure.
+*
+*   A module has one air rate for everything it sends and hears, so only a
+*   node that exchanged frames with no other node for LINK_SILENCE_MS moves
+*   away from the saved rate, and goes back once another one shows up.
+*
+*   Rates are written with TEMP_CONFIG (C2), the EEPROM keeps the saved
+*   configuration and the module starts with it after a power cycle. A switch
+*   is started and then advanced by link_poll, decisions and negotiations wait
+*   until the module runs the new rate.
+*
+*   Control payload: kind | rate | proposal number
+*/
+#ifndef LORA_LINK_ADAPT
+#define LORA_LINK_ADAPT 0
+#endif
+
+// Air rate bits of the speed byte, 0 = 0.3k to 5 = 19.2k (6 and 7 are 19.2k as well)
+#define LINK_RATE_MIN 0
+#define LINK_RATE_MAX 5
+
+// Frames acknowledged or lost per decision
+#define LINK_WINDOW 8
+// Retransmissions per window, in percent of LINK_WINDOW, that step the rate down
+#define LINK_DOWN_RETRY_PCT 50
+// Retransmissions per window at most, in percent, for a window to count as clean
+#define LINK_UP_RETRY_PCT 25
+// Clean windows in a row before trying the next faster rate
+#define LINK_UP_WINDOWS 2
+// A rate that had to be left is not tried again before this
+#define LINK_HOLD_MS 120000
+// PROPOSE sent this many times per rate
+#define LINK_PROPOSE_TRIES 3
+// Nothing heard for this long returns to the saved rate, other nodes heard within it keep the saved rate
+#define LINK_SILENCE_MS 180000
+
+// Records per aggregated frame on a clean link, fewer the more frames need retransmissions
+#define LINK_MAX_RECORDS 8
+
+typedef struct
+{
+    bool enabled;
+    uint8_t base_rate;     // Air rate of the saved configuration
+    uint8_t rate;          // Air rate in use
+    uint8_t peer[3];       // Destination the decisions are based on
+    uint32_t proposals;    // Rate changes proposed
+    uint32_t accepted;     // Proposals of other nodes answered
+    uint32_t switches;     // Air rate changes written to the module
+    uint32_t failures;     // Proposals that got no answer on either rate, or were refused
+    uint32_t fallbacks;    // Returns to the saved rate after silence
+    uint32_t config_errors;
+    uint8_t max_records;   // See link_max_records
+} link_stats_t;
+
+typedef struct
+{
+    // Starts writing the configuration with the rate with TEMP_CONFIG, returns false if the module is busy
+    bool (*start_air_rate)(uint8_t rate);
+
+    // Advances the write, E32_CONFIG_BUSY until the module took the rate or it failed, never blocks
+    e32_config_status_t (*poll_air_rate)(void);
+} link_hooks_t;
+
+/**
+*   @brief Starts over at the air rate of the configuration, call again whenever it changes
+*   @param config Module configuration in use, { SAVE_CONFIG, ADDH, ADDL, SPED, CHAN, OPTION }
+*   @param hooks Switches the module
+*/
+void link_init(const uint8_t config[E32_CONFIG_LEN], const link_hooks_t *hooks);
+
+// Turns the controller on or off, off returns to the saved rate
+void link_enable(bool enable);
+
+// Takes decisions and drives a negotiation, call from the main loop
+void link_poll(void);
+
+/**
+*   @brief Notes that the link works, call for every received frame
+*   @return true if the frame was a FRAME_FLAG_LINK control frame and is handled
+*/
+bool link_on_frame(const frame_t *frame);
+
+/**
+*   @brief Time link_poll has a timeout to check
+*   @return false if no negotiation is in progress
+*/
+bool link_next_deadline(uint32_t *deadline);
+
+// Records a frame should carry at most for the current link quality, 1 to LINK_MAX_RECORDS
+size_t link_max_records(void);
+
+void link_get_stats(link_stats_t *stats);
+
+// Prints the state on stdio
+void link_print(void);
+
+#endif
@@ -4,10 +4,58 @@
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "hardware/i2c.h"
+#include "hardware/sync.h"
 
 // OLED Library
 #include "ssd1306.h"
 
+// Interrupt driven UART receive
+#include "e32_uart.h"
+
+// EBYTE module control and configuration
+#include "e32.h"
+
+// Transmit queue
+#include "tx_queue.h"
+
+// Framing of messages sent over the air
+#include "frame.h"
+
+// Acknowledged delivery for fixed transmission
+#include "reliable.h"
+
+// Payload compression
+#include "compress.h"
+
+// Display side: message log and refreshes, LORA_DUAL_CORE
+#include "ui.h"
+
+// Node settings kept in flash
+#include "node_store.h"
+
+// Commands on the USB serial port
+#include "console.h"
+
+// Module modes between messages and sleep, LORA_POWER_SAVE
+#include "power.h"
+
+// Counters of all modules, printed by the stats command
+#include "telemetry.h"
+
+// Event timestamps for profiling, LORA_TRACE
+#include "trace.h"
+
+// Latency and throughput probes, started with the bench command
+#include "bench.h"
+// Steps the air rate with the link quality, switched on with the link command
+#include "link.h"
+// Messages to the same destination share a frame
+#include "batch.h"
+
+#if LORA_DUAL_CORE
+#include "pico/multicore.h"
+#endif
+
 // Define the UART ID and GPIO pins
 #define UART_ID uart0
 #define I2C_ID i2c1
@@ -24,24 +72,21 @@
 #define SEND_MODULE_1_BTN_PIN 21
 #define SEND_MODULE_2_BTN_PIN 22
 
-#define SAVE_CONFIG 0xC0 // Save configurations even after module power down
-
-// Define module modes
-#define NORMAL_MODE 0
-#define WAKEUP_MODE 1
-#define POWERSAVING_MODE 2
-#define SLEEP_MODE 3
-
-// Define char limits for OLED
-#define CHAR_LIMIT_X 120
-#define CHAR_LIMIT_Y 54
-
 // Define baud rates
 #define BAUD_RATE 9600
 #define OLED_BAUD_RATE 400000
 
 #define DEBOUNCE_50MS 50000
-#define PIN_RECOVER 1000
+#define CONFIG_RETRY_MS 2000
+
+// Max bytes taken out of the receive ring per main loop pass
+#define RX_BATCH_SIZE 64
+
+// Fixed transmissions wait for an acknowledgement and are retransmitted, broadcasts stay fire-and-forget
+#define RELIABLE_DELIVERY 1
+
+// Codec tried on every message, frames are sent uncompressed when it does not help
+#define TX_CODEC CODEC_DICT_LZ
 
 /**
 *   Define node addresses
@@ -54,11 +99,26 @@ const uint8_t NODE3_CONFIG[] = { SAVE_CONFIG, 0x00, 0x03, 0x1A, 0x06, 0xC4 };
 const uint8_t NODE4_CONFIG[] = { SAVE_CONFIG, 0x00, 0x04, 0x1A, 0x06, 0xC4 };
 const uint8_t NODE5_CONFIG[] = { SAVE_CONFIG, 0x00, 0x05, 0x1A, 0x06, 0xC4 };
 
+// Built in configuration of this node, used until other settings are saved from the console
+#define NODE_CONFIG NODE2_CONFIG
+
+// Built in configuration, the host simulation points it at another node before app_init
+const uint8_t *node_config = NODE_CONFIG;
+
+// Built in destinations and messages of the broadcast, send module 1 and send module 2 buttons
+const node_peer_t BUILTIN_PEERS[NODE_STORE_PEERS] = {
+    { 0xFF, 0xFF, 0x04, "Hello, everyone!" }, // FFFF broadcasts to all devices in the channel
+    { 0x00, 0x02, 0x04, "Hello, Node 2!" },
+    { 0x00, 0x01, 0x02, "Hello, Node 1!" },
+};
+
+// Settings in use, from flash or built in. Its address and channel are sent as the source of every frame
+node_settings_t settings;
+
 char combined_string[50];
-volatile int counter = 0;
 
-int xCursor = 0;
-int yCursor = 6;
+// Reassembles frames from the received bytes
+frame_parser_t rx_parser;
 
 // Structure for OLED display configuration
 ssd1306_t disp;
@@ -67,251 +127,184 @@ ssd1306_t disp;
 void flush_buffer()
 {
     stdio_flush();
-    unsigned long amt = time_us_64();
 
-    while (uart_is_readable(UART_ID))
-    {
-        uart_getc(UART_ID);
-        if ((time_us_64() - amt) > 5000) 
-        {
-            printf("runaway\n");
-            break;
-        }
-    }
+    // The receive interrupt owns the FIFO, the discard empties it with the interrupt held off
+    telemetry_count_flush(e32_uart_discard());
 }
 
 /**
-*   @brief Changes the mode of the EBYTE module
+*   @brief Changes the mode of the EBYTE module, returns before the module is ready
 *   @param mode Input which mode to set the module (NORMAL_MODE, WAKEUP_MODE, POWERSAVING_MODE, SLEEP_MODE)
+*   @param done Called from the main loop once AUX reports the module ready or the switch timed out, may be NULL
+*   @param user_data Passed to done
 */
-void change_mode(int mode)
+void change_mode(int mode, e32_mode_cb_t done, void *user_data)
 {
     flush_buffer();
-    switch (mode)
-    {
-    case 0:
-        // Set M0 and M1 pins to LOW
-        gpio_put(M0_PIN, 0);
-        gpio_put(M1_PIN, 0);
-        break;
-    case 1:
-        // Set M0 pin to HIGH and M1 pin to LOW
-        gpio_put(M0_PIN, 1);
-        gpio_put(M1_PIN, 0);
-        break;
-    case 2:
-        // Set M0 pin to LOW and M1 pin to HIGH
-        gpio_put(M0_PIN, 0);
-        gpio_put(M1_PIN, 1);
-        break;
-    case 3:
-        // Set M0 and M1 pins to HIGH
-        gpio_put(M0_PIN, 1);
-        gpio_put(M1_PIN, 1);
-        break;
-    default:
-        // Invalid mode, do nothing
-        break;
-    }
+    e32_change_mode(mode, done, user_data);
 }
 
-// Gets the current configuration of the EBYTE module and prints it out
-void get_current_config()
+/**
+ * @brief Waits until no frame is left on the UART or in the module buffer
+ *
+ * Outside NORMAL_MODE the module takes UART bytes for commands, a frame still being
+ * written would corrupt its parameters. tx_queue_poll only runs from the main loop,
+ * so no new frame starts meanwhile, queued ones go out once the module is back.
+ */
+static void drain_tx()
 {
-    flush_buffer();
-    sleep_ms(PIN_RECOVER);
-
-    uint8_t rxbuffer[6];
-
-    // Sends 0xC1 three times in SLEEP_MODE
-    unsigned char hex = 0xC1;
-    uint8_t hexcode[] = {hex, hex, hex}; 
-    uart_write_blocking(UART_ID, hexcode, sizeof(hexcode));
+    while (!e32_uart_tx_idle())
+    {
+        tight_loop_contents();
+    }
 
-    // Module automatically sends back current configurations
-    uart_read_blocking(UART_ID, rxbuffer, 6);
-    for (int i = 0; i < sizeof(rxbuffer) / sizeof(uint8_t); i++)
+    // A module that never raises AUX again is not waited for, the bytes at least reached it
+    uint32_t start = time_us_32();
+    while (!tx_queue_drained() && time_us_32() - start < E32_AUX_TIMEOUT_MS * 1000)
     {
-        printf("0x%02X ", rxbuffer[i]);
+        tight_loop_contents();
     }
-    printf("\n");
 }
 
 /**
- * @brief Set the configuration of the EBYTE module
+ * @brief Writes a configuration to the EBYTE module and returns it to NORMAL_MODE
  * @param hexArr Set of parameters used to change the configurations
+ * @return true if the module echoed the configuration back
  */
-void set_config(uint8_t hexArr[])
+bool configure_module(const uint8_t hexArr[])
 {
-    flush_buffer();
-    sleep_ms(PIN_RECOVER);
-
-    uint8_t rxbuffer[6];
-
-    uart_write_blocking(UART_ID, hexArr, 6);
+    // An air rate switch of the link controller is finished first, link_init forgets it afterwards
+    while (e32_config_poll() == E32_CONFIG_BUSY)
+    {
+        tight_loop_contents();
+    }
+    drain_tx();
+    e32_config_start(hexArr);
 
-    uart_read_blocking(UART_ID, rxbuffer, 6);
-    for (int i = 0; i < sizeof(rxbuffer) / sizeof(uint8_t); i++)
+    // Only takes as long as the module needs to switch modes and reply
+    e32_config_status_t status;
+    while ((status = e32_config_poll()) == E32_CONFIG_BUSY)
     {
-        printf("0x%02X ", rxbuffer[i]);
+#if !LORA_DUAL_CORE
+        ui_poll();
+#endif
+        tight_loop_contents();
     }
-    printf("\n");
+
+    return status == E32_CONFIG_DONE;
 }
 
 void reset_config()
 {
     flush_buffer();
 
-    uint8_t rxbuffer[6];
-    unsigned char hex = 0xC4;
+    unsigned char hex = RESET_MODULE;
     uint8_t hexcode[] = {hex, hex, hex};
 
     uart_write_blocking(UART_ID, hexcode, sizeof(hexcode));
 }
 
-// Send messages to be transmitted
-void send_msg(uint gpio, uint32_t events)
+/**
+ * @brief Wraps a message or a record list in a frame and queues it, called by batch_poll
+ * @param flags FRAME_FLAG_RECORDS if raw is a record list
+ * @return BATCH_SEND_BUSY if the send window or the TX queue is full, BATCH_SEND_TOO_LONG if the
+ *         payload does not fit into a frame even compressed
+ */
+batch_send_status_t send_payload(uint8_t addhigh, uint8_t addlow, uint8_t channel, uint8_t flags, const uint8_t *raw, size_t raw_len)
 {
-    flush_buffer();
-    uint32_t current_time = time_us_32();
-    static uint32_t button_last_time = 0;
+    static uint8_t seq = 0;
+    const uint8_t src[] = { settings.config[1], settings.config[2], settings.config[4] };
+    uint8_t frame[FRAME_MAX_LEN];
+    uint8_t payload[FRAME_MAX_PAYLOAD];
 
-    if (gpio == BROADCAST_BTN_PIN && events == GPIO_IRQ_EDGE_RISE)
+    size_t payload_len = frame_pack_payload(TX_CODEC, raw, raw_len, payload, &flags);
+    if (payload_len == 0)
     {
-        if (current_time - button_last_time >= DEBOUNCE_50MS)
-        {
-            // AUX pin high = Buffer is empty
-            // If empty, we allow sending
-            if (gpio_get(AUX_PIN))
-            {
-                // Transmission mode takes in first three bytes to direct transmit to
-                unsigned char addhigh, addlow, channel;
-                // FFFF in this case broadcasts the message to all devices in the provided channel
-                addhigh = 0xFF;
-                addlow = 0XFF; 
-                channel = 0x04;
-
-                char msg_to_send[] = "Hello, everyone!";
-                uint8_t bytes_to_send[] = {addhigh, addlow, channel};
-                size_t bytes_len = sizeof(bytes_to_send);
-                size_t msg_len = sizeof(msg_to_send);
-
-                // Create a new combined array with enough space for both arrays
-                uint8_t combined_array[bytes_len + msg_len];
-
-                // Copy bytes_to_send into combined_array
-                memcpy(combined_array, bytes_to_send, bytes_len);
-
-                // Convert characters from msg_to_send to uint8_t and append them to combined_array
-                for (size_t i = 0; i < msg_len; i++)
-                {
-                    combined_array[bytes_len + i] = (uint8_t)msg_to_send[i];
-                }
-                uart_write_blocking(UART_ID, combined_array, sizeof(combined_array));
-            }
-            button_last_time = current_time;
-        }
+        return BATCH_SEND_TOO_LONG;
     }
 
-    if (gpio == SEND_MODULE_1_BTN_PIN && events == GPIO_IRQ_EDGE_RISE)
+    if (RELIABLE_DELIVERY && !(addhigh == 0xFF && addlow == 0xFF))
     {
-        if (current_time - button_last_time >= DEBOUNCE_50MS)
+        // The session byte goes in front
+        if (payload_len > RELIABLE_MAX_PAYLOAD)
         {
-            if (gpio_get(AUX_PIN))
-            {
-                unsigned char addhigh, addlow, channel;
-                addhigh = 0x00;
-                addlow = 0X02;
-                channel = 0x04;
-                char msg_to_send[] = "Hello, Node 2!";
-                uint8_t bytes_to_send[] = {addhigh, addlow, channel};
-                size_t bytes_len = sizeof(bytes_to_send);
-                size_t msg_len = sizeof(msg_to_send);
-
-                // Create a new combined array with enough space for both arrays
-                uint8_t combined_array[bytes_len + msg_len];
-
-                // Copy bytes_to_send into combined_array
-                memcpy(combined_array, bytes_to_send, bytes_len);
-
-                // Convert characters from msg_to_send to uint8_t and append them to combined_array
-                for (size_t i = 0; i < msg_len; i++)
-                {
-                    combined_array[bytes_len + i] = (uint8_t)msg_to_send[i];
-                }
-                uart_write_blocking(UART_ID, combined_array, sizeof(combined_array));
-            }
-            button_last_time = current_time;
+            return BATCH_SEND_TOO_LONG;
         }
+        return reliable_send(addhigh, addlow, channel, flags, payload, payload_len) ? BATCH_SEND_OK : BATCH_SEND_BUSY;
     }
 
-    if (gpio == SEND_MODULE_2_BTN_PIN && events == GPIO_IRQ_EDGE_RISE)
+    size_t len = frame_encode(frame, flags, src, seq, payload, payload_len);
+    if (len == 0)
     {
-        if (current_time - button_last_time >= DEBOUNCE_50MS)
-        {
-            if (gpio_get(AUX_PIN))
-            {
-                unsigned char addhigh, addlow, channel;
-                addhigh = 0x00;
-                addlow = 0X01;
-                channel = 0x02;
-                char msg_to_send[] = "Hello, Node 1!";
-                uint8_t bytes_to_send[] = {addhigh, addlow, channel};
-                size_t bytes_len = sizeof(bytes_to_send);
-                size_t msg_len = sizeof(msg_to_send);
-
-                // Create a new combined array with enough space for both arrays
-                uint8_t combined_array[bytes_len + msg_len];
-
-                // Copy bytes_to_send into combined_array
-                memcpy(combined_array, bytes_to_send, bytes_len);
-
-                // Convert characters from msg_to_send to uint8_t and append them to combined_array
-                for (size_t i = 0; i < msg_len; i++)
-                {
-                    combined_array[bytes_len + i] = (uint8_t)msg_to_send[i];
-                }
-                uart_write_blocking(UART_ID, combined_array, sizeof(combined_array));
-            }
-            button_last_time = current_time;
-        }
+        return BATCH_SEND_TOO_LONG;
     }
+    if (!tx_queue_push(addhigh, addlow, channel, frame, len))
+    {
+        return BATCH_SEND_BUSY;
+    }
+    seq++;
+    return BATCH_SEND_OK;
 }
 
-// Draws line separators on OLED display to split into 4 rows
-void draw_separators()
+const batch_hooks_t batch_hooks = {
+    .send = send_payload,
+};
+
+// Adds a message to the batch of its destination, the terminating '\0' is sent along
+void send_text(unsigned char addhigh, unsigned char addlow, unsigned char channel, const char *msg)
 {
-    ssd1306_draw_line(&disp, 0, 15, 127, 15);
-    ssd1306_draw_line(&disp, 0, 31, 127, 31);
-    ssd1306_draw_line(&disp, 0, 47, 127, 47);
-    ssd1306_draw_line(&disp, 0, 63, 127, 63);
+    batch_add(addhigh, addlow, channel, (const uint8_t *)msg, strlen(msg) + 1);
 }
 
-// Print data received from the RX_PIN
-void print_on_oled(char rxchar)
+// Send messages to be transmitted, only queues them, tx_queue_poll writes them to the module from the main loop
+void send_msg(uint gpio, uint32_t events)
 {
-    if(xCursor!=CHAR_LIMIT_X)
+    uint32_t current_time = time_us_32();
+    static uint32_t button_last_time = 0;
+
+    if (events != GPIO_IRQ_EDGE_RISE || current_time - button_last_time < DEBOUNCE_50MS)
     {
-        ssd1306_draw_char(&disp, xCursor, yCursor, 1, rxchar);
-        ssd1306_show(&disp);
-        xCursor += 8;
+        return;
     }
-    else if(xCursor==CHAR_LIMIT_X && yCursor!=CHAR_LIMIT_Y)
+
+    int button;
+
+    if (gpio == BROADCAST_BTN_PIN)
     {
-        yCursor += 16;
-        xCursor = 0;
-        ssd1306_draw_char(&disp, xCursor, yCursor, 1, rxchar);
-        ssd1306_show(&disp);
+        button = 0;
+    }
+    else if (gpio == SEND_MODULE_1_BTN_PIN)
+    {
+        button = 1;
+    }
+    else if (gpio == SEND_MODULE_2_BTN_PIN)
+    {
+        button = 2;
     }
     else
     {
-        xCursor = 0;
-        yCursor = 6;
-        ssd1306_clear(&disp);
-        draw_separators();
-        ssd1306_draw_char(&disp, xCursor, yCursor, 1, rxchar);
-        ssd1306_show(&disp);
-        xCursor += 8;
+        return;
+    }
+
+    // Transmission mode takes in first three bytes to direct transmit to
+    const node_peer_t *peer = &settings.peers[button];
+    send_text(peer->addh, peer->addl, peer->chan, peer->msg);
+    power_note_message();
+    button_last_time = current_time;
+}
+
+// Single GPIO interrupt callback, routes AUX edges to the module driver and button edges to send_msg
+void gpio_callback(uint gpio, uint32_t events)
+{
+    if (gpio == AUX_PIN)
+    {
+        e32_aux_irq(events);
+    }
+    else
+    {
+        TRACE(TRACE_BUTTON_BEGIN, gpio);
+        send_msg(gpio, events);
+        TRACE(TRACE_BUTTON_END, gpio);
     }
 }
 
@@ -320,23 +313,127 @@ void printCombinedString()
     printf("%s\n", combined_string);
 }
 
-void receive_msg_hex()
-{   
-    if (uart_is_readable(UART_ID))
+// Shows one received message and logs it on the serial monitor
+void show_message(const uint8_t *msg, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len && n < sizeof(combined_string) - 1 && msg[n] != '\0')
     {
-        char rxchar = uart_getc(UART_ID);
-        combined_string[counter] = rxchar;
-        print_on_oled(rxchar);
-        counter += 1;
+        combined_string[n] = (char)msg[n];
+        n++;
+    }
+    combined_string[n] = '\0';
+
+    // Drawn into the next rows by the display side, the display scrolls once it is full
+    ui_post(combined_string, n);
+    power_note_message();
+
+    printCombinedString();
+}
+
+// Called by the frame parser for every frame that passed its CRC check
+void on_frame(const frame_t *frame, void *user_data)
+{
+    (void)user_data;
+
+    // Air rate negotiation, every frame also tells the link controller the link works
+    if (link_on_frame(frame))
+    {
+        return;
+    }
+
+    // Acknowledgements and repeated frames are not shown, the session byte is taken off the payload
+    frame_t rx = *frame;
+    if (!reliable_on_frame(&rx))
+    {
+        return;
+    }
+    frame = &rx;
+
+    if (frame->flags & FRAME_FLAG_PROBE)
+    {
+        bench_on_frame(frame);
+        return;
+    }
+
+    // Same frame with the decompressed message as payload
+    uint8_t raw[COMPRESS_MAX_RAW];
+    size_t raw_len;
+    if (!frame_unpack_payload(frame, raw, sizeof(raw), &raw_len))
+    {
+        printf("undecodable frame from %02X%02X\n", frame->src_high, frame->src_low);
+        return;
+    }
 
-        if (rxchar == '\n' || rxchar == '\0')
+    frame_t msg = *frame;
+    msg.payload = raw;
+    msg.len = (uint8_t)raw_len;
+
+    if (msg.flags & FRAME_FLAG_RECORDS)
+    {
+        size_t offset = 0;
+        const uint8_t *record;
+        size_t len;
+
+        while (frame_next_record(&msg, &offset, &record, &len))
         {
-            counter = 0;
-            printCombinedString();
+            show_message(record, len);
         }
     }
+    else
+    {
+        show_message(msg.payload, msg.len);
+    }
+}
+
+// Consumes everything the UART interrupt has queued since the last pass
+void receive_msg_hex()
+{
+    uint8_t batch[RX_BATCH_SIZE];
+    size_t len = e32_uart_read(batch, sizeof(batch));
+
+    if (len > 0)
+    {
+        frame_parser_feed(&rx_parser, batch, len, on_frame, NULL);
+    }
+}
+
+// Configuration with the air rate the link controller is switching to
+static uint8_t air_rate_config[E32_CONFIG_LEN];
+
+/**
+ * @brief Starts switching the module to another air rate until the next power cycle or configuration
+ * @param rate Air rate bits of the speed byte
+ * @return false if the module is busy with another configuration
+ */
+bool start_air_rate(uint8_t rate)
+{
+    memcpy(air_rate_config, settings.config, E32_CONFIG_LEN);
+    air_rate_config[0] = TEMP_CONFIG;
+    air_rate_config[3] = (uint8_t)((air_rate_config[3] & ~0x07) | (rate & 0x07));
+
+    return e32_config_start(air_rate_config);
+}
+
+// Advances the switch from the main loop, app_poll leaves the UART to it meanwhile
+e32_config_status_t poll_air_rate()
+{
+    e32_config_status_t status = e32_config_poll();
+
+    if (status == E32_CONFIG_DONE)
+    {
+        flush_buffer();
+        bench_init(air_rate_config);
+    }
+    return status;
 }
 
+const link_hooks_t link_hooks = {
+    .start_air_rate = start_air_rate,
+    .poll_air_rate = poll_air_rate,
+};
+
 void init_config()
 {
     stdio_init_all();
@@ -348,14 +445,20 @@ void init_config()
     uart_set_hw_flow(UART_ID, false, false);
     uart_set_format(UART_ID, 8, 1, UART_PARITY_NONE);
 
-    gpio_init(M0_PIN);
-    gpio_set_dir(M0_PIN, GPIO_OUT);
-    gpio_init(M1_PIN);
-    gpio_set_dir(M1_PIN, GPIO_OUT);
+    // Received bytes, including configuration replies, are buffered by the UART interrupt
+    e32_uart_init(UART_ID);
 
-    // AUX pin on the module is an output pin so we set GPIO as input
-    gpio_init(AUX_PIN);
-    gpio_set_dir(AUX_PIN, GPIO_IN);
+    e32_init(UART_ID, M0_PIN, M1_PIN, AUX_PIN);
+    tx_queue_init(BAUD_RATE);
+    frame_parser_init(&rx_parser);
+    telemetry_init(&rx_parser);
+
+    const uint8_t self[] = { settings.config[1], settings.config[2], settings.config[4] };
+    reliable_init(self);
+    bench_init(settings.config);
+    link_init(settings.config, &link_hooks);
+    batch_init(&batch_hooks);
+    gpio_set_irq_enabled_with_callback(AUX_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &gpio_callback);
 
     // Initializing buttons
     gpio_init(BROADCAST_BTN_PIN);
@@ -370,37 +473,189 @@ void init_config()
     gpio_set_function(SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(SCL_PIN, GPIO_FUNC_I2C);
 
-    const char configMsg[] = "CONFIG DONE";
-
     disp.external_vcc=false;
     ssd1306_init(&disp, 128, 64, 0x3C, I2C_ID);
     ssd1306_clear(&disp);
+}
 
-    ssd1306_draw_string(&disp, 30, 32, 1, configMsg);
-    ssd1306_show(&disp);
-    ssd1306_clear(&disp);
+void builtin_settings(node_settings_t *s)
+{
+    memcpy(s->config, node_config, E32_CONFIG_LEN);
+    memcpy(s->peers, BUILTIN_PEERS, sizeof(s->peers));
 }
 
-int main()
+// Writes the settings to the module, which is left alone if it already has them
+void apply_settings(const node_settings_t *s)
 {
+    bool same_address = memcmp(s->config + 1, settings.config + 1, 2) == 0 && s->config[4] == settings.config[4];
+
+    // Buttons read the peers from their interrupt
+    uint32_t irq = save_and_disable_interrupts();
+    settings = *s;
+    restore_interrupts(irq);
+
+    if (!configure_module(settings.config))
+    {
+        printf("module configuration failed: %s\n", e32_error_str(e32_config_error()));
+    }
+    flush_buffer();
+
+    // Frames in flight were sent from the old address
+    if (!same_address)
+    {
+        const uint8_t self[] = { settings.config[1], settings.config[2], settings.config[4] };
+        reliable_init(self);
+    }
+    bench_init(settings.config);
+    link_init(settings.config, &link_hooks);
+}
+
+// Flash writes keep interrupts off longer than the UART RX FIFO lasts at 9600 baud,
+// in SLEEP_MODE the module neither receives nor writes to the UART, nothing is half read
+static void park_module()
+{
+    // An air rate switch of the link controller is finished first
+    while (e32_config_poll() == E32_CONFIG_BUSY)
+    {
+        tight_loop_contents();
+    }
+    drain_tx();
+
+    e32_change_mode(SLEEP_MODE, NULL, NULL);
+    while (e32_mode_poll() == E32_MODE_SWITCHING)
+    {
+        tight_loop_contents();
+    }
+}
+
+// Flash can not be read while it is written, core 1 is parked meanwhile.
+// apply_settings brings the module back to NORMAL_MODE.
+bool save_settings(const node_settings_t *s)
+{
+    park_module();
+#if LORA_DUAL_CORE
+    multicore_lockout_start_blocking();
+#endif
+    bool ok = node_store_save(s);
+#if LORA_DUAL_CORE
+    multicore_lockout_end_blocking();
+#endif
+
+    apply_settings(s);
+    return ok;
+}
+
+void reset_settings()
+{
+    node_settings_t s;
+
+    park_module();
+#if LORA_DUAL_CORE
+    multicore_lockout_start_blocking();
+#endif
+    node_store_erase();
+#if LORA_DUAL_CORE
+    multicore_lockout_end_blocking();
+#endif
+
+    builtin_settings(&s);
+    apply_settings(&s);
+}
+
+const console_hooks_t console_hooks = {
+    .save = save_settings,
+    .reset = reset_settings,
+};
+
+// Brings up the peripherals, configures the module and enables the buttons
+void app_init()
+{
+    if (!node_store_load(&settings))
+    {
+        builtin_settings(&settings);
+    }
+
     init_config();
 
-    change_mode(SLEEP_MODE);
-    get_current_config();
-    set_config(NODE2_CONFIG);
-    change_mode(NORMAL_MODE);
+    const char configMsg[] = "CONFIG DONE";
+    const char noModuleMsg[] = "NO E32 MODULE";
+
+    while (!configure_module(settings.config))
+    {
+        ssd1306_clear(&disp);
+        ssd1306_draw_string(&disp, 10, 32, 1, noModuleMsg);
+        ssd1306_show(&disp);
+        sleep_ms(CONFIG_RETRY_MS);
+    }
     flush_buffer();
-    draw_separators();
+
+    ssd1306_clear(&disp);
+    ssd1306_draw_string(&disp, 30, 32, 1, configMsg);
     ssd1306_show(&disp);
 
-    gpio_set_irq_enabled_with_callback(BROADCAST_BTN_PIN, GPIO_IRQ_EDGE_RISE, true, &send_msg);
-    gpio_set_irq_enabled_with_callback(SEND_MODULE_1_BTN_PIN, GPIO_IRQ_EDGE_RISE, true, &send_msg);
-    gpio_set_irq_enabled_with_callback(SEND_MODULE_2_BTN_PIN, GPIO_IRQ_EDGE_RISE, true, &send_msg);
-    
-    while (1)
+    // From here on only the UI touches the display
+    ui_init(&disp);
+#if LORA_DUAL_CORE
+    multicore_launch_core1(ui_core1_main);
+#endif
+
+    gpio_set_irq_enabled_with_callback(BROADCAST_BTN_PIN, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
+    gpio_set_irq_enabled_with_callback(SEND_MODULE_1_BTN_PIN, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
+    gpio_set_irq_enabled_with_callback(SEND_MODULE_2_BTN_PIN, GPIO_IRQ_EDGE_RISE, true, &gpio_callback);
+
+    console_init(&settings, &console_hooks);
+
+    // Module goes to its idle mode on the first pass
+    power_init();
+}
+
+// One pass of the main loop, never blocks
+void app_poll()
+{
+    // Replies of an air rate switch come through the same UART, link_poll reads them
+    if (!e32_config_reading())
     {
         receive_msg_hex();
     }
 
+    // Completes mode switches requested through change_mode
+    e32_mode_poll();
+
+    // Retransmits unacknowledged frames
+    reliable_poll();
+
+    // Negotiates and switches the air rate
+    link_poll();
+
+    // Frames the messages whose batch is due
+    batch_poll();
+
+    // Queues due benchmark probes
+    bench_poll();
+
+    // Writes queued button messages once the module can take them
+    tx_queue_poll();
+
+    // Settings changes typed on the USB serial port
+    console_poll();
+
+#if !LORA_DUAL_CORE
+    // Draws received messages, core 1 does this on its own in the dual core build
+    ui_poll();
+#endif
+
+    // Parks the module and sleeps until the next interrupt when there is nothing left to do
+    power_poll();
+}
+
+int main()
+{
+    app_init();
+
+    while (1)
+    {
+        app_poll();
+    }
+
     return 0;
-}
\ No newline at end of file
+}
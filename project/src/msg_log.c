@@ -0,0 +1,146 @@
+#include <string.h>
+
+#include "msg_log.h"
+
+static ssd1306_t *log_disp;
+
+// Rows of RAM, the one at top_row is shown first, rows_used fill up after a clear
+static uint32_t rows;
+static uint32_t cols;
+static uint32_t top_row = 0;
+static uint32_t rows_used = 0;
+
+// Part of a message shown on one row
+typedef struct
+{
+    uint8_t start;
+    uint8_t len;
+} line_t;
+
+/**
+*   @brief Word wraps a message into rows
+*
+*   Lines break after the last space that fits, the spaces at the break are
+*   dropped. Words longer than a row are split. An empty message still gets
+*   one row.
+*
+*   @param lines At least MSG_LOG_TEXT_MAX entries
+*   @return Number of rows
+*/
+static uint32_t layout(const char *text, size_t len, line_t *lines)
+{
+    uint32_t n = 0;
+    size_t pos = 0;
+
+    while (pos < len && text[pos] == ' ')
+    {
+        pos++;
+    }
+
+    while (pos < len)
+    {
+        size_t end = pos + cols < len ? pos + cols : len;
+
+        // Break at the last space when a word would be cut
+        if (end < len && text[end] != ' ')
+        {
+            size_t sp = end;
+            while (sp > pos && text[sp - 1] != ' ')
+            {
+                sp--;
+            }
+            if (sp > pos)
+            {
+                end = sp;
+            }
+        }
+
+        size_t stop = end;
+        while (stop > pos && text[stop - 1] == ' ')
+        {
+            stop--;
+        }
+        lines[n].start = (uint8_t)pos;
+        lines[n].len = (uint8_t)(stop - pos);
+        n++;
+
+        pos = end;
+        while (pos < len && text[pos] == ' ')
+        {
+            pos++;
+        }
+    }
+
+    if (n == 0)
+    {
+        lines[0].start = 0;
+        lines[0].len = 0;
+        n = 1;
+    }
+    return n;
+}
+
+static void draw_row(uint32_t row, const char *text, size_t len)
+{
+    uint32_t y = row * MSG_LOG_ROW_HEIGHT;
+
+    ssd1306_clear_square(log_disp, 0, y, log_disp->width, MSG_LOG_ROW_HEIGHT);
+    for (size_t i = 0; i < len; i++)
+    {
+        ssd1306_draw_char(log_disp, i * MSG_LOG_CHAR_PITCH, y + MSG_LOG_TEXT_OFFSET, 1, text[i]);
+    }
+    ssd1306_draw_hline(log_disp, 0, y + MSG_LOG_ROW_HEIGHT - 1, log_disp->width);
+}
+
+// Takes the next free row, or the oldest one and scrolls it to the bottom
+static uint32_t next_row()
+{
+    if (rows_used < rows)
+    {
+        return (top_row + rows_used++) % rows;
+    }
+
+    uint32_t row = top_row;
+    top_row = (top_row + 1) % rows;
+    ssd1306_set_start_line(log_disp, top_row * MSG_LOG_ROW_HEIGHT);
+    return row;
+}
+
+// Draws a message into the rows after the last one, the last rows are kept if it does not fit
+static void append(const char *text, size_t len)
+{
+    line_t lines[MSG_LOG_TEXT_MAX];
+    uint32_t n = layout(text, len, lines);
+    uint32_t first = n > rows ? n - rows : 0;
+
+    for (uint32_t r = first; r < n; r++)
+    {
+        draw_row(next_row(), text + lines[r].start, lines[r].len);
+    }
+}
+
+static void clear_rows()
+{
+    top_row = 0;
+    rows_used = 0;
+    ssd1306_set_start_line(log_disp, 0);
+    ssd1306_clear(log_disp);
+
+    for (uint32_t r = 0; r < rows; r++)
+    {
+        ssd1306_draw_hline(log_disp, 0, r * MSG_LOG_ROW_HEIGHT + MSG_LOG_ROW_HEIGHT - 1, log_disp->width);
+    }
+}
+
+void msg_log_init(ssd1306_t *disp)
+{
+    log_disp = disp;
+    rows = disp->height / MSG_LOG_ROW_HEIGHT;
+    cols = disp->width / MSG_LOG_CHAR_PITCH;
+    clear_rows();
+}
+
+void msg_log_add(const char *text, size_t len)
+{
+    append(text, len > MSG_LOG_TEXT_MAX ? MSG_LOG_TEXT_MAX : len);
+}
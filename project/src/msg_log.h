@@ -0,0 +1,34 @@
+#ifndef MSG_LOG_H
+#define MSG_LOG_H
+
+#include <stddef.h>
+
+#include "ssd1306.h"
+
+// Longer messages are cut
+#define MSG_LOG_TEXT_MAX 48
+
+// Rows of 16 pixels with the text 6 pixels below the top and a separator on the last line
+#define MSG_LOG_ROW_HEIGHT 16
+#define MSG_LOG_TEXT_OFFSET 6
+#define MSG_LOG_CHAR_PITCH 8
+
+/**
+*   @brief Clears the display and shows empty rows
+*   @param disp Display the log owns, its start line is used for scrolling
+*/
+void msg_log_init(ssd1306_t *disp);
+
+/**
+*   @brief Appends a message below the previous one, word wrapped over as many rows as it needs
+*
+*   Once the display is full, every new row reuses the RAM of the oldest one
+*   and the display start line moves down by one row. Scrolling costs one
+*   command plus the data of the new row instead of a full clear and redraw.
+*
+*   @param text Message, does not need to be terminated
+*   @param len Number of characters
+*/
+void msg_log_add(const char *text, size_t len);
+
+#endif
@@ -0,0 +1,86 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "node_store.h"
+#include "frame.h"
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+// Last sector of flash, far away from the program
+#define NODE_STORE_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+#define NODE_STORE_MAGIC 0x45444F4Eu // "NODE"
+#define NODE_STORE_VERSION 1
+
+// Record as written to the first page of the sector, CRC-16 over everything before it
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    node_settings_t settings;
+    uint16_t crc;
+} record_t;
+
+_Static_assert(sizeof(record_t) <= FLASH_PAGE_SIZE, "node settings do not fit into one flash page");
+
+static const record_t *stored()
+{
+    return (const record_t *)(XIP_BASE + NODE_STORE_OFFSET);
+}
+
+static uint16_t record_crc(const record_t *r)
+{
+    return frame_crc16((const uint8_t *)r, offsetof(record_t, crc));
+}
+
+bool node_store_load(node_settings_t *settings)
+{
+    const record_t *r = stored();
+
+    if (r->magic != NODE_STORE_MAGIC || r->version != NODE_STORE_VERSION || r->size != sizeof(node_settings_t) ||
+        r->crc != record_crc(r))
+    {
+        return false;
+    }
+
+    memcpy(settings, &r->settings, sizeof(*settings));
+    return true;
+}
+
+bool node_store_save(const node_settings_t *settings)
+{
+    // Page buffer, unused bytes stay erased
+    static uint8_t page[FLASH_PAGE_SIZE];
+    record_t *r = (record_t *)page;
+
+    memset(page, 0xFF, sizeof(page));
+    memset(r, 0, sizeof(*r));
+    r->magic = NODE_STORE_MAGIC;
+    r->version = NODE_STORE_VERSION;
+    r->size = sizeof(node_settings_t);
+    memcpy(&r->settings, settings, sizeof(*settings));
+    r->crc = record_crc(r);
+
+    // Every save costs an erase cycle of the sector
+    if (memcmp(stored(), r, sizeof(*r)) == 0)
+    {
+        return true;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+    flash_range_erase(NODE_STORE_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(NODE_STORE_OFFSET, page, FLASH_PAGE_SIZE);
+    restore_interrupts(irq);
+
+    return memcmp(stored(), r, sizeof(*r)) == 0;
+}
+
+void node_store_erase()
+{
+    uint32_t irq = save_and_disable_interrupts();
+    flash_range_erase(NODE_STORE_OFFSET, FLASH_SECTOR_SIZE);
+    restore_interrupts(irq);
+}
@@ -0,0 +1,50 @@
+#ifndef NODE_STORE_H
+#define NODE_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "e32.h"
+
+// One peer per button: broadcast, send module 1, send module 2
+#define NODE_STORE_PEERS 3
+#define NODE_STORE_MSG_LEN 24
+
+// Destination and message of one button
+typedef struct
+{
+    uint8_t addh;
+    uint8_t addl;
+    uint8_t chan;
+    char msg[NODE_STORE_MSG_LEN]; // Terminated
+} node_peer_t;
+
+// Settings of a node, kept in the last sector of the Pico's flash
+typedef struct
+{
+    uint8_t config[E32_CONFIG_LEN]; // { SAVE_CONFIG, high address, low address, speed, channel, options }
+    node_peer_t peers[NODE_STORE_PEERS];
+} node_settings_t;
+
+/**
+*   @brief Reads the settings stored in flash
+*   @param settings Filled in if valid settings were found, untouched otherwise
+*   @return false if the sector is erased, from another version or corrupt
+*/
+bool node_store_load(node_settings_t *settings);
+
+/**
+*   @brief Writes the settings to flash, skipped if they are already stored
+*
+*   Interrupts are disabled during erase and program, code running from
+*   flash on the other core has to be locked out by the caller. UART bytes
+*   arriving meanwhile overrun the FIFO, the caller parks the module first.
+*
+*   @return false if reading back gave different settings
+*/
+bool node_store_save(const node_settings_t *settings);
+
+// Erases the stored settings, the next boot uses the built in ones
+void node_store_erase(void);
+
+#endif
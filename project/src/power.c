@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "power.h"
+#include "e32.h"
+#include "e32_uart.h"
+#include "tx_queue.h"
+#include "reliable.h"
+#include "bench.h"
+#include "link.h"
+#include "batch.h"
+#include "ui.h"
+#include "trace.h"
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+// Mode the module waits in between messages and the one it sends in
+#define IDLE_MODE (LORA_POWER_SAVE ? POWERSAVING_MODE : TX_MODE)
+#define TX_MODE (LORA_WAKEUP_TX ? WAKEUP_MODE : NORMAL_MODE)
+
+static power_stats_t stats;
+static volatile uint32_t messages = 0;
+
+// Start of the stretch the core has been running, or sleeping while asleep is set
+static uint64_t awake_since = 0;
+static uint64_t asleep_since = 0;
+static volatile bool asleep = false;
+
+static bool parked = false;
+static uint64_t parked_since = 0;
+
+// Awake time since the core was last idle, and the message count at that point
+static uint64_t burst_awake_us = 0;
+static uint32_t burst_start = 0;
+
+void power_init()
+{
+    memset(&stats, 0, sizeof(stats));
+    awake_since = time_us_64();
+    asleep = false;
+    parked = false;
+    burst_awake_us = 0;
+    burst_start = messages;
+}
+
+void power_note_message()
+{
+    messages++;
+}
+
+static void track_parked(bool now_parked, uint64_t now)
+{
+    if (now_parked && !parked)
+    {
+        parked_since = now;
+    }
+    else if (!now_parked && parked)
+    {
+        stats.parked_us += now - parked_since;
+    }
+    parked = now_parked;
+}
+
+// Module idle and nothing left for the core, the awake time so far is charged to the messages it handled
+static void end_burst(uint64_t now)
+{
+    uint32_t count = messages;
+    uint32_t n = count - burst_start;
+    uint64_t awake = burst_awake_us + (now - awake_since);
+
+    if (n > 0)
+    {
+        uint32_t each = (uint32_t)(awake / n);
+
+        stats.msg_awake_us += awake;
+        stats.msg_awake_us_last = each;
+        if (each > stats.msg_awake_us_max)
+        {
+            stats.msg_awake_us_max = each;
+        }
+        printf("[power] awake %lu us for %lu message(s), %lu us each\n", (unsigned long)awake, (unsigned long)n,
+               (unsigned long)each);
+    }
+
+    // Wakeups without messages only count towards the totals
+    stats.awake_us += now - awake_since;
+    awake_since = now;
+    burst_awake_us = 0;
+    burst_start = count;
+}
+
+static void fall_asleep()
+{
+    TRACE(TRACE_SLEEP_BEGIN, 0);
+    asleep_since = time_us_64();
+    stats.awake_us += asleep_since - awake_since;
+    burst_awake_us += asleep_since - awake_since;
+    asleep = true;
+}
+
+static void wake_up()
+{
+    asleep = false;
+    awake_since = time_us_64();
+    stats.asleep_us += awake_since - asleep_since;
+    stats.wakeups++;
+    TRACE(TRACE_SLEEP_END, 0);
+}
+
+// Waits in __wfi unless something arrived since the last main loop pass
+static void sleep_until_interrupt(bool idle)
+{
+    if (idle)
+    {
+        end_burst(time_us_64());
+    }
+
+    // Checked with interrupts off, whatever raises one from here on ends the __wfi at once
+    uint32_t irq = save_and_disable_interrupts();
+
+    if (e32_uart_available() == 0 && tx_queue_depth() == 0 && (LORA_DUAL_CORE || ui_idle()))
+    {
+        fall_asleep();
+        __wfi();
+        wake_up();
+    }
+
+    // Pending handlers run here
+    restore_interrupts(irq);
+}
+
+// Waits for an acknowledgement, the frame or the next retransmission timeout ends the wait
+static void sleep_until_deadline(uint32_t deadline)
+{
+    int32_t left = (int32_t)(deadline - time_us_32());
+
+    if (left <= 0 || e32_uart_available() > 0 || !(LORA_DUAL_CORE || ui_idle()))
+    {
+        return;
+    }
+
+    fall_asleep();
+    best_effort_wfe_or_timeout(make_timeout_time_us((uint64_t)left));
+    wake_up();
+}
+
+// Keeps the earlier of a deadline and the one next() reports, returns whether there is one
+static bool merge_deadline(bool waiting, uint32_t *deadline, bool (*next)(uint32_t *))
+{
+    uint32_t other;
+    if (!next(&other))
+    {
+        return waiting;
+    }
+    if (!waiting || (int32_t)(other - *deadline) < 0)
+    {
+        *deadline = other;
+    }
+    return true;
+}
+
+void power_poll()
+{
+    // A configuration switches the modes itself and has to be polled
+    if (e32_config_poll() == E32_CONFIG_BUSY)
+    {
+        return;
+    }
+
+    e32_mode_status_t status = e32_mode_poll();
+    int mode = e32_mode();
+
+    track_parked(mode == POWERSAVING_MODE && status == E32_MODE_READY, time_us_64());
+
+    // The end of a switch is timed after AUX rises, it has to be polled
+    if (status == E32_MODE_SWITCHING)
+    {
+        return;
+    }
+
+    bool tx_idle = tx_queue_idle();
+    uint32_t deadline;
+    bool waiting = reliable_next_deadline(&deadline);
+
+    // A benchmark run keeps the module ready for echoes and wakes up for its next probe
+    waiting = merge_deadline(waiting, &deadline, bench_next_deadline);
+
+    // So does an air rate negotiation for the answer
+    waiting = merge_deadline(waiting, &deadline, link_next_deadline);
+
+    // And messages waiting for their batch to be sent
+    waiting = merge_deadline(waiting, &deadline, batch_next_deadline);
+    int want = !tx_idle || waiting ? TX_MODE : IDLE_MODE;
+
+    // Never switched while the module sends or hands over received bytes, AUX rising comes back here
+    if (mode != want && e32_aux_ready())
+    {
+        e32_change_mode(want, NULL, NULL);
+        return;
+    }
+
+    if (!LORA_POWER_SAVE)
+    {
+        return;
+    }
+
+    if (!e32_aux_ready() || (mode == IDLE_MODE && want == IDLE_MODE))
+    {
+        // Module busy raises AUX when done, parked module lowers it for the next frame
+        sleep_until_interrupt(e32_aux_ready());
+    }
+    else if (tx_idle && waiting)
+    {
+        // Everything sent, the module stays in the transmit mode to hear acknowledgements without a preamble
+        sleep_until_deadline(deadline);
+    }
+}
+
+void power_get_stats(power_stats_t *out)
+{
+    uint64_t now = time_us_64();
+
+    *out = stats;
+    out->messages = messages;
+    if (asleep)
+    {
+        out->asleep_us += now - asleep_since;
+    }
+    else
+    {
+        out->awake_us += now - awake_since;
+    }
+    if (parked)
+    {
+        out->parked_us += now - parked_since;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Battery node: the module listens in POWERSAVING_MODE (WOR) and the core sleeps between messages
+#ifndef LORA_POWER_SAVE
+#define LORA_POWER_SAVE 0
+#endif
+
+// Frames go out in WAKEUP_MODE with the preamble modules in POWERSAVING_MODE wait for.
+// Every node that talks to a battery node needs it, battery nodes have it by default
+#ifndef LORA_WAKEUP_TX
+#define LORA_WAKEUP_TX LORA_POWER_SAVE
+#endif
+
+typedef struct
+{
+    uint32_t wakeups;           // Sleeps ended by an interrupt
+    uint32_t messages;          // Messages sent or received
+    uint64_t awake_us;          // Core running since power_init
+    uint64_t asleep_us;         // Core waiting for an interrupt
+    uint64_t parked_us;         // Module listening in POWERSAVING_MODE
+    uint64_t msg_awake_us;      // Awake time of the bursts that carried messages, over messages gives the average
+    uint32_t msg_awake_us_last; // Awake time per message of the last burst
+    uint32_t msg_awake_us_max;  // Highest awake time per message of a burst
+} power_stats_t;
+
+// Starts the time accounting, call once the module is configured
+void power_init(void);
+
+/**
+*   @brief Keeps the module in the right mode and sleeps when there is nothing to do, call at the end of the main loop
+*
+*   The module is switched to the transmit mode while frames wait to be sent
+*   or acknowledged and back to its idle mode once AUX reports its buffer
+*   empty. With LORA_POWER_SAVE the idle mode is POWERSAVING_MODE and the core
+*   waits in __wfi for AUX, the UART, a button or USB. Never sleeps while a
+*   mode switch, a retransmission timeout or a display refresh needs polling.
+*/
+void power_poll(void);
+
+// Counts a message shown or queued by a button, safe to call from interrupts
+void power_note_message(void);
+
+// Copies the counters, the current awake or parked stretch included
+void power_get_stats(power_stats_t *stats);
+
+#endif
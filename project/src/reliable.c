@@ -0,0 +1,440 @@
+#include <string.h>
+
+#include "reliable.h"
+#include "tx_queue.h"
+
+#include "pico/stdlib.h"
+#include "pico/rand.h"
+#include "hardware/sync.h"
+
+// Received sequence numbers remembered per source for duplicate detection
+#define RX_HISTORY 32
+
+typedef struct
+{
+    bool used;
+    uint8_t addr[3];
+    uint32_t last_use;
+
+    // Sending to this peer
+    uint8_t session;
+    uint8_t next_seq;
+    uint8_t in_flight;
+    bool have_rtt;
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint32_t rto_us;
+    uint32_t delivered;
+    uint32_t lost;
+    uint32_t retries;
+
+    // Receiving from this peer, bit n of rx_seen = rx_highest - n was received
+    bool rx_valid;
+    uint8_t rx_session;
+    uint8_t rx_highest;
+    uint32_t rx_seen;
+} peer_t;
+
+typedef struct
+{
+    bool used;
+    uint8_t peer;
+    uint8_t seq;
+    uint8_t tries;
+    uint32_t sent_at;
+    uint32_t deadline;
+    uint8_t len;
+    uint8_t frame[FRAME_MAX_LEN];
+} slot_t;
+
+static uint8_t self_addr[3];
+static uint8_t next_session;
+static peer_t peers[RELIABLE_MAX_PEERS];
+static slot_t slots[RELIABLE_SLOTS];
+static reliable_stats_t stats;
+
+static bool deadline_passed(uint32_t deadline)
+{
+    return (int32_t)(time_us_32() - deadline) >= 0;
+}
+
+// Looks up a peer, optionally taking over the least recently used idle entry. Interrupts must be off.
+static peer_t *find_peer(const uint8_t addr[3], bool add)
+{
+    peer_t *victim = NULL;
+
+    for (int i = 0; i < RELIABLE_MAX_PEERS; i++)
+    {
+        peer_t *p = &peers[i];
+        if (p->used && memcmp(p->addr, addr, 3) == 0)
+        {
+            p->last_use = time_us_32();
+            return p;
+        }
+        if (!p->used)
+        {
+            if (!victim || victim->used)
+            {
+                victim = p;
+            }
+        }
+        else if (p->in_flight == 0 && (!victim || (victim->used && (int32_t)(p->last_use - victim->last_use) < 0)))
+        {
+            victim = p;
+        }
+    }
+
+    if (!add || !victim)
+    {
+        return NULL;
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    victim->used = true;
+    memcpy(victim->addr, addr, 3);
+    victim->last_use = time_us_32();
+    victim->rto_us = RELIABLE_RTO_INIT_MS * 1000;
+    victim->session = next_session++;
+    return victim;
+}
+
+static void transmit(slot_t *s)
+{
+    const peer_t *p = &peers[s->peer];
+
+    // A full TX queue is handled like a lost frame, the timeout sends it again
+    tx_queue_push(p->addr[0], p->addr[1], p->addr[2], s->frame, s->len);
+    s->sent_at = time_us_32();
+    s->deadline = s->sent_at + p->rto_us;
+}
+
+// Jacobson/Karels estimate, only fed with frames that were sent once
+static void update_rtt(peer_t *p, uint32_t rtt_us)
+{
+    if (!p->have_rtt)
+    {
+        p->srtt_us = rtt_us;
+        p->rttvar_us = rtt_us / 2;
+        p->have_rtt = true;
+    }
+    else
+    {
+        uint32_t err = rtt_us > p->srtt_us ? rtt_us - p->srtt_us : p->srtt_us - rtt_us;
+        p->rttvar_us = (3 * p->rttvar_us + err) / 4;
+        p->srtt_us = (7 * p->srtt_us + rtt_us) / 8;
+    }
+
+    uint32_t rto = p->srtt_us + 4 * p->rttvar_us;
+    if (rto < RELIABLE_RTO_MIN_MS * 1000)
+    {
+        rto = RELIABLE_RTO_MIN_MS * 1000;
+    }
+    if (rto > RELIABLE_RTO_MAX_MS * 1000)
+    {
+        rto = RELIABLE_RTO_MAX_MS * 1000;
+    }
+    p->rto_us = rto;
+}
+
+// Records a received sequence number, returns true if it was seen before
+static bool is_duplicate(peer_t *p, uint8_t session, uint8_t seq)
+{
+    int8_t diff = (int8_t)(seq - p->rx_highest);
+
+    // The sender restarted or took a new entry for us, its sequence numbers start over
+    if (p->rx_valid && session != p->rx_session)
+    {
+        p->rx_valid = false;
+        stats.restarts++;
+    }
+
+    // First frame of a session, or so far behind that older frames were all missed
+    if (!p->rx_valid || diff <= -RX_HISTORY)
+    {
+        p->rx_valid = true;
+        p->rx_session = session;
+        p->rx_highest = seq;
+        p->rx_seen = 1;
+        return false;
+    }
+
+    if (diff > 0)
+    {
+        p->rx_seen = diff >= RX_HISTORY ? 1 : (p->rx_seen << diff) | 1;
+        p->rx_highest = seq;
+        return false;
+    }
+
+    uint32_t bit = 1u << -diff;
+    if (p->rx_seen & bit)
+    {
+        return true;
+    }
+    p->rx_seen |= bit;
+    return false;
+}
+
+void reliable_init(const uint8_t self[3])
+{
+    memcpy(self_addr, self, 3);
+    next_session = (uint8_t)get_rand_32();
+    memset(peers, 0, sizeof(peers));
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool reliable_send(uint8_t addhigh, uint8_t addlow, uint8_t channel, uint8_t flags, const uint8_t *payload, size_t len)
+{
+    const uint8_t addr[3] = { addhigh, addlow, channel };
+
+    if ((addhigh == 0xFF && addlow == 0xFF) || len > RELIABLE_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+
+    peer_t *p = find_peer(addr, true);
+    slot_t *s = NULL;
+
+    if (p && p->in_flight < RELIABLE_WINDOW)
+    {
+        for (int i = 0; i < RELIABLE_SLOTS && !s; i++)
+        {
+            if (!slots[i].used)
+            {
+                s = &slots[i];
+            }
+        }
+    }
+
+    if (!s)
+    {
+        stats.rejected++;
+        restore_interrupts(irq);
+        return false;
+    }
+
+    s->used = true;
+    s->peer = p - peers;
+    s->seq = p->next_seq++;
+    s->tries = 1;
+    uint8_t body[FRAME_MAX_PAYLOAD];
+    body[0] = p->session;
+    memcpy(body + RELIABLE_HEADER_LEN, payload, len);
+    s->len = frame_encode(s->frame, flags | FRAME_FLAG_ACK_REQ, self_addr, s->seq, body, RELIABLE_HEADER_LEN + len);
+    p->in_flight++;
+    stats.sent++;
+
+    transmit(s);
+
+    restore_interrupts(irq);
+    return true;
+}
+
+void reliable_poll()
+{
+    for (int i = 0; i < RELIABLE_SLOTS; i++)
+    {
+        slot_t *s = &slots[i];
+
+        if (!s->used || !deadline_passed(s->deadline))
+        {
+            continue;
+        }
+
+        uint32_t irq = save_and_disable_interrupts();
+        peer_t *p = &peers[s->peer];
+
+        if (s->tries >= RELIABLE_MAX_TRIES)
+        {
+            s->used = false;
+            p->in_flight--;
+            p->lost++;
+            stats.lost++;
+        }
+        else
+        {
+            // Back off, the link is slower or lossier than the estimate
+            p->rto_us = p->rto_us * 2 > RELIABLE_RTO_MAX_MS * 1000 ? RELIABLE_RTO_MAX_MS * 1000 : p->rto_us * 2;
+            s->tries++;
+            p->retries++;
+            stats.retries++;
+            transmit(s);
+        }
+
+        restore_interrupts(irq);
+    }
+}
+
+bool reliable_on_frame(frame_t *frame)
+{
+    const uint8_t src[3] = { frame->src_high, frame->src_low, frame->src_channel };
+
+    if (frame->flags & FRAME_FLAG_ACK)
+    {
+        uint32_t irq = save_and_disable_interrupts();
+        peer_t *p = find_peer(src, false);
+
+        // An acknowledgement for an older session of ours matches nothing
+        if (p && (frame->len != RELIABLE_HEADER_LEN || frame->payload[0] != p->session))
+        {
+            p = NULL;
+        }
+
+        for (int i = 0; p && i < RELIABLE_SLOTS; i++)
+        {
+            slot_t *s = &slots[i];
+            if (s->used && &peers[s->peer] == p && s->seq == frame->seq)
+            {
+                if (s->tries == 1)
+                {
+                    update_rtt(p, time_us_32() - s->sent_at);
+                }
+                s->used = false;
+                p->in_flight--;
+                p->delivered++;
+                stats.delivered++;
+                break;
+            }
+        }
+
+        restore_interrupts(irq);
+        return false;
+    }
+
+    if (!(frame->flags & FRAME_FLAG_ACK_REQ))
+    {
+        return true;
+    }
+    if (frame->len < RELIABLE_HEADER_LEN)
+    {
+        return false;
+    }
+
+    uint8_t session = frame->payload[0];
+    frame->payload += RELIABLE_HEADER_LEN;
+    frame->len -= RELIABLE_HEADER_LEN;
+
+    // Acknowledge even duplicates, the first acknowledgement may have been lost
+    uint8_t ack[FRAME_OVERHEAD + RELIABLE_HEADER_LEN];
+    size_t len = frame_encode(ack, FRAME_FLAG_ACK, self_addr, frame->seq, &session, RELIABLE_HEADER_LEN);
+    if (tx_queue_push(src[0], src[1], src[2], ack, len))
+    {
+        stats.acks_sent++;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+    peer_t *p = find_peer(src, true);
+    bool duplicate = p && is_duplicate(p, session, frame->seq);
+    restore_interrupts(irq);
+
+    if (duplicate)
+    {
+        stats.duplicates++;
+    }
+    return !duplicate;
+}
+
+size_t reliable_in_flight(uint8_t addhigh, uint8_t addlow, uint8_t channel)
+{
+    const uint8_t addr[3] = { addhigh, addlow, channel };
+
+    uint32_t irq = save_and_disable_interrupts();
+    peer_t *p = find_peer(addr, false);
+    size_t n = p ? p->in_flight : 0;
+    restore_interrupts(irq);
+
+    return n;
+}
+
+size_t reliable_pending()
+{
+    size_t n = 0;
+
+    uint32_t irq = save_and_disable_interrupts();
+    for (int i = 0; i < RELIABLE_SLOTS; i++)
+    {
+        n += slots[i].used;
+    }
+    restore_interrupts(irq);
+
+    return n;
+}
+
+bool reliable_next_deadline(uint32_t *deadline)
+{
+    bool found = false;
+
+    uint32_t irq = save_and_disable_interrupts();
+    for (int i = 0; i < RELIABLE_SLOTS; i++)
+    {
+        const slot_t *s = &slots[i];
+        if (s->used && (!found || (int32_t)(s->deadline - *deadline) < 0))
+        {
+            *deadline = s->deadline;
+            found = true;
+        }
+    }
+    restore_interrupts(irq);
+
+    return found;
+}
+
+void reliable_get_stats(reliable_stats_t *out)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    *out = stats;
+    restore_interrupts(irq);
+}
+
+size_t reliable_get_peer_stats(reliable_peer_stats_t *out, size_t max)
+{
+    size_t n = 0;
+
+    uint32_t irq = save_and_disable_interrupts();
+    for (int i = 0; i < RELIABLE_MAX_PEERS && n < max; i++)
+    {
+        const peer_t *p = &peers[i];
+        if (p->used)
+        {
+            memcpy(out[n].addr, p->addr, 3);
+            out[n].delivered = p->delivered;
+            out[n].lost = p->lost;
+            out[n].retries = p->retries;
+            out[n].last_use_us = p->last_use;
+            n++;
+        }
+    }
+    restore_interrupts(irq);
+
+    return n;
+}
+
+// Multiplies a time by num/den, limited to the largest timeout
+static uint32_t scale(uint32_t us, uint32_t num, uint32_t den)
+{
+    uint64_t v = (uint64_t)us * num / den;
+    return v > RELIABLE_RTO_MAX_MS * 1000 ? RELIABLE_RTO_MAX_MS * 1000 : (uint32_t)v;
+}
+
+void reliable_scale_rtt(uint32_t num, uint32_t den)
+{
+    uint32_t irq = save_and_disable_interrupts();
+    for (int i = 0; i < RELIABLE_MAX_PEERS; i++)
+    {
+        peer_t *p = &peers[i];
+        p->srtt_us = scale(p->srtt_us, num, den);
+        p->rttvar_us = scale(p->rttvar_us, num, den);
+        p->rto_us = scale(p->rto_us, num, den);
+    }
+    for (int i = 0; i < RELIABLE_SLOTS; i++)
+    {
+        slot_t *s = &slots[i];
+        if (s->used)
+        {
+            s->deadline = s->sent_at + scale(s->deadline - s->sent_at, num, den);
+        }
+    }
+    restore_interrupts(irq);
+}
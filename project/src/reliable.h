@@ -0,0 +1,121 @@
+#ifndef RELIABLE_H
+#define RELIABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame.h"
+
+// Destinations and sources tracked at once, the oldest entry is reused when full
+#define RELIABLE_MAX_PEERS 4
+// Unacknowledged frames per destination
+#define RELIABLE_WINDOW 4
+// Unacknowledged frames in total, each slot keeps a copy of its frame for retransmission.
+// 68 bytes a slot and 44 a peer, the layer takes about 760 bytes of RAM.
+#define RELIABLE_SLOTS 8
+// Transmissions of a frame before it is counted as lost
+#define RELIABLE_MAX_TRIES 5
+
+/**
+*   Every FRAME_FLAG_ACK_REQ payload starts with the session byte of the
+*   sender, drawn at boot and changed whenever an entry is taken for a
+*   destination, since the sequence numbers start over at 0 then. Receivers
+*   forget the sequence numbers seen from a source when its session changes,
+*   acknowledgements carry the session back so one left over from before does
+*   not acknowledge a new frame.
+*/
+#define RELIABLE_HEADER_LEN 1
+#define RELIABLE_MAX_PAYLOAD (FRAME_MAX_PAYLOAD - RELIABLE_HEADER_LEN)
+
+// Retransmit timeout bounds, the timeout adapts to the measured round trip in between
+#define RELIABLE_RTO_INIT_MS 1500
+#define RELIABLE_RTO_MIN_MS 300
+#define RELIABLE_RTO_MAX_MS 10000
+
+typedef struct
+{
+    uint32_t sent;       // Frames accepted by reliable_send
+    uint32_t delivered;  // Frames acknowledged by their destination
+    uint32_t lost;       // Frames given up after RELIABLE_MAX_TRIES
+    uint32_t retries;    // Retransmissions
+    uint32_t rejected;   // reliable_send calls refused because the window was full
+    uint32_t acks_sent;
+    uint32_t duplicates; // Received frames already seen, acknowledged again but not delivered
+    uint32_t restarts;   // Sources seen with a new session, their sequence history was dropped
+} reliable_stats_t;
+
+// Outcome of the frames sent to one destination, counted from when its entry was taken
+typedef struct
+{
+    uint8_t addr[3];
+    uint32_t delivered;
+    uint32_t lost;
+    uint32_t retries;
+    uint32_t last_use_us; // Last frame sent to or received from it
+} reliable_peer_stats_t;
+
+/**
+*   @brief Prepares the reliable delivery layer
+*   @param self Own address high, address low and channel, sent as frame source
+*/
+void reliable_init(const uint8_t self[3]);
+
+/**
+*   @brief Sends a payload that is retransmitted until the destination acknowledges it
+*   @param addhigh Destination high address, broadcast (FFFF) is not allowed
+*   @param addlow Destination low address
+*   @param channel Destination channel
+*   @param flags Extra FRAME_FLAG_* bits for the payload
+*   @param payload Payload bytes, copied
+*   @param len Payload length, at most RELIABLE_MAX_PAYLOAD
+*   @return false if the destination window or the slot pool is full
+*
+*   Safe to call from interrupts.
+*/
+bool reliable_send(uint8_t addhigh, uint8_t addlow, uint8_t channel, uint8_t flags, const uint8_t *payload, size_t len);
+
+// Retransmits frames whose timeout expired, call from the main loop
+void reliable_poll(void);
+
+/**
+*   @brief Handles acknowledgement state of a received frame, call for every frame from the parser
+*   @param frame Received frame, the session byte is taken off the payload of FRAME_FLAG_ACK_REQ frames
+*   @return true if the frame carries new data for the application
+*
+*   Consumes ACK frames, acknowledges FRAME_FLAG_ACK_REQ frames and filters their duplicates.
+*/
+bool reliable_on_frame(frame_t *frame);
+
+// Unacknowledged frames to a destination
+size_t reliable_in_flight(uint8_t addhigh, uint8_t addlow, uint8_t channel);
+
+// Frames still waiting for an acknowledgement or a retransmission, to any destination
+size_t reliable_pending(void);
+
+/**
+*   @brief Earliest retransmission timeout of the pending frames
+*   @param deadline Set to the time_us_32 value at which reliable_poll next has work
+*   @return false if nothing is pending
+*/
+bool reliable_next_deadline(uint32_t *deadline);
+
+// Copies the counters
+void reliable_get_stats(reliable_stats_t *stats);
+
+/**
+*   @brief Copies the counters of the destinations currently tracked
+*   @param out Array of at least max entries
+*   @return Number of entries written, an entry reused for another destination starts from zero
+*/
+size_t reliable_get_peer_stats(reliable_peer_stats_t *out, size_t max);
+
+/**
+*   @brief Stretches the round trip estimate and timeout of every destination
+*
+*   Called after the air rate went down by num/den, so frames already in
+*   flight and the next ones are not retransmitted before the slower answer.
+*/
+void reliable_scale_rtt(uint32_t num, uint32_t den);
+
+#endif
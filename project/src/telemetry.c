@@ -0,0 +1,93 @@
+#include <stdio.h>
+
+#include "telemetry.h"
+
+#include "pico/stdlib.h"
+
+static const frame_parser_t *frame_source = NULL;
+
+static volatile uint32_t flush_discarded = 0;
+
+void telemetry_init(const frame_parser_t *parser)
+{
+    frame_source = parser;
+}
+
+void telemetry_count_flush(size_t bytes)
+{
+    flush_discarded += (uint32_t)bytes;
+}
+
+void telemetry_snapshot(telemetry_t *t)
+{
+    t->uptime_ms = (uint32_t)(time_us_64() / 1000);
+
+    e32_uart_get_stats(&t->uart);
+    t->flush_discarded = flush_discarded;
+
+    // The parser runs in the main loop, the same context as the caller
+    if (frame_source)
+    {
+        t->frames = frame_source->stats;
+    }
+    else
+    {
+        t->frames = (frame_stats_t){ 0 };
+    }
+
+    tx_queue_get_stats(&t->tx);
+    t->tx_depth = (uint32_t)tx_queue_depth();
+    batch_get_stats(&t->batch);
+    reliable_get_stats(&t->reliable);
+    ui_get_stats(&t->ui);
+    power_get_stats(&t->power);
+}
+
+// Whole milliseconds of a microsecond count
+static unsigned long ms(uint64_t us)
+{
+    return (unsigned long)(us / 1000);
+}
+
+void telemetry_print()
+{
+    telemetry_t t;
+    telemetry_snapshot(&t);
+
+    printf("uptime   %lu ms\n", (unsigned long)t.uptime_ms);
+    printf("uart     rx %lu  tx %lu  ring overruns %lu  fifo overruns %lu  line errors %lu\n",
+           (unsigned long)t.uart.rx_bytes, (unsigned long)t.uart.tx_bytes, (unsigned long)t.uart.ring_overruns,
+           (unsigned long)t.uart.fifo_overruns, (unsigned long)t.uart.line_errors);
+    printf("flush    discarded %lu\n", (unsigned long)t.flush_discarded);
+    printf("frames   ok %lu  crc errors %lu  bad length %lu  skipped bytes %lu\n", (unsigned long)t.frames.frames_ok,
+           (unsigned long)t.frames.crc_errors, (unsigned long)t.frames.bad_length, (unsigned long)t.frames.discarded);
+    printf("tx       depth %lu  max %lu  queued %lu  sent %lu  dropped %lu\n", (unsigned long)t.tx_depth,
+           (unsigned long)t.tx.max_depth, (unsigned long)t.tx.queued, (unsigned long)t.tx.sent,
+           (unsigned long)t.tx.dropped);
+    printf("batch    messages %lu  frames %lu  batched %lu  max records %lu  busy %lu  dropped %lu\n",
+           (unsigned long)t.batch.messages, (unsigned long)t.batch.frames, (unsigned long)t.batch.batched,
+           (unsigned long)t.batch.max_records, (unsigned long)t.batch.busy, (unsigned long)t.batch.dropped);
+    printf("reliable sent %lu  delivered %lu  lost %lu  retries %lu  rejected %lu  acks %lu  duplicates %lu  restarts %lu\n",
+           (unsigned long)t.reliable.sent, (unsigned long)t.reliable.delivered, (unsigned long)t.reliable.lost,
+           (unsigned long)t.reliable.retries, (unsigned long)t.reliable.rejected, (unsigned long)t.reliable.acks_sent,
+           (unsigned long)t.reliable.duplicates, (unsigned long)t.reliable.restarts);
+    printf("ui       queued %lu  dropped %lu  max depth %lu  backlog %lu  drawn %lu  draw max %lu us\n",
+           (unsigned long)t.ui.queued, (unsigned long)t.ui.dropped, (unsigned long)t.ui.max_depth,
+           (unsigned long)t.ui.backlog, (unsigned long)t.ui.drawn, (unsigned long)t.ui.draw_us_max);
+    printf("ui poll  total %lu us  max %lu us\n", (unsigned long)t.ui.poll_us, (unsigned long)t.ui.poll_us_max);
+    printf("display  frames %lu  i2c errors %lu  timeouts %lu  show max %lu us\n", (unsigned long)t.ui.frames,
+           (unsigned long)t.ui.i2c_errors, (unsigned long)t.ui.i2c_timeouts, (unsigned long)t.ui.show_us_max);
+
+    printf("show us ");
+    for (int i = 0; i < UI_SHOW_BUCKETS; i++)
+    {
+        const char *bound = i < UI_SHOW_BUCKETS - 1 ? "<=" : ">";
+        uint32_t limit = (uint32_t)UI_SHOW_BUCKET_US << (i < UI_SHOW_BUCKETS - 1 ? i : i - 1);
+        printf(" %s%lu:%lu", bound, (unsigned long)limit, (unsigned long)t.ui.show_hist[i]);
+    }
+    printf("\n");
+
+    printf("power    awake %lu ms  asleep %lu ms  wor %lu ms  wakeups %lu  messages %lu  last %lu us/msg\n",
+           ms(t.power.awake_us), ms(t.power.asleep_us), ms(t.power.parked_us), (unsigned long)t.power.wakeups,
+           (unsigned long)t.power.messages, (unsigned long)t.power.msg_awake_us_last);
+}
@@ -0,0 +1,46 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "e32_uart.h"
+#include "frame.h"
+#include "tx_queue.h"
+#include "batch.h"
+#include "reliable.h"
+#include "ui.h"
+#include "power.h"
+
+// Counters of every module, copied in one go so they can be compared
+typedef struct
+{
+    uint32_t uptime_ms;
+    e32_uart_stats_t uart;
+    uint32_t flush_discarded; // Received bytes thrown away by flush_buffer
+    frame_stats_t frames;
+    tx_queue_stats_t tx;
+    uint32_t tx_depth;        // Frames waiting right now
+    batch_stats_t batch;
+    reliable_stats_t reliable;
+    ui_stats_t ui;
+    power_stats_t power;
+} telemetry_t;
+
+/**
+*   @brief Sets where the frame counters are read from
+*   @param parser Parser fed with the received bytes
+*/
+void telemetry_init(const frame_parser_t *parser);
+
+// Counts bytes dropped when the receive path was flushed
+void telemetry_count_flush(size_t bytes);
+
+// Copies the counters of all modules
+void telemetry_snapshot(telemetry_t *t);
+
+// Prints a snapshot on stdio, the USB serial port
+void telemetry_print(void);
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdio.h>
+
+#include "trace.h"
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#if LORA_TRACE
+
+// Indices wrap at 2^32, which only stays consistent with % TRACE_DEPTH for a power of two
+_Static_assert((TRACE_DEPTH & (TRACE_DEPTH - 1)) == 0, "TRACE_DEPTH must be a power of two");
+
+// One ring per core, each core writes its own with interrupts disabled, so no lock is needed
+static trace_record_t ring[TRACE_CORES][TRACE_DEPTH];
+static uint32_t head[TRACE_CORES];
+static uint32_t tail[TRACE_CORES];
+
+// Set while dumping, events in the meantime are not recorded
+static volatile bool paused = false;
+
+// Set while a core writes a record, the dump waits for the other core to finish its record
+static volatile bool writing[TRACE_CORES];
+
+void trace_record(trace_event_t event, uint16_t arg)
+{
+    uint core = get_core_num();
+    uint32_t irq = save_and_disable_interrupts();
+
+    // Announced before paused is checked, so either the dump sees the record coming or the record sees the pause
+    writing[core] = true;
+    __dmb();
+    if (!paused)
+    {
+        trace_record_t *r = &ring[core][head[core] % TRACE_DEPTH];
+        r->time_us = time_us_32();
+        r->event = (uint8_t)event;
+        r->core = (uint8_t)core;
+        r->arg = arg;
+        head[core]++;
+    }
+    __dmb();
+    writing[core] = false;
+
+    restore_interrupts(irq);
+}
+
+void trace_dump()
+{
+    uint32_t records = 0;
+    uint32_t lost = 0;
+
+    paused = true;
+    __dmb();
+
+    for (int c = 0; c < TRACE_CORES; c++)
+    {
+        while (writing[c])
+        {
+            tight_loop_contents();
+        }
+    }
+    __dmb();
+
+    for (int c = 0; c < TRACE_CORES; c++)
+    {
+        uint32_t n = head[c] - tail[c];
+        if (n > TRACE_DEPTH)
+        {
+            lost += n - TRACE_DEPTH;
+            tail[c] = head[c] - TRACE_DEPTH;
+        }
+        records += head[c] - tail[c];
+    }
+
+    printf("trace begin %lx %lx\n", (unsigned long)records, (unsigned long)lost);
+    for (int c = 0; c < TRACE_CORES; c++)
+    {
+        for (; tail[c] != head[c]; tail[c]++)
+        {
+            const trace_record_t *r = &ring[c][tail[c] % TRACE_DEPTH];
+            printf("T %08lx %02x %x %04x\n", (unsigned long)r->time_us, r->event, r->core, r->arg);
+        }
+    }
+    printf("trace end\n");
+
+    __dmb();
+    paused = false;
+}
+
+#else
+
+void trace_record(trace_event_t event, uint16_t arg)
+{
+    (void)event;
+    (void)arg;
+}
+
+void trace_dump()
+{
+    printf("built without LORA_TRACE\n");
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Timestamps of hot path events in a RAM ring, dumped by the trace console command
+#ifndef LORA_TRACE
+#define LORA_TRACE 0
+#endif
+
+// Records kept per core, a power of two, the oldest ones are overwritten
+#ifndef TRACE_DEPTH
+#define TRACE_DEPTH 1024
+#endif
+#define TRACE_CORES 2
+
+// Pairs marked BEGIN/END become slices in the trace viewer, the others instants
+typedef enum
+{
+    TRACE_UART_RX = 1,  // UART interrupt moved bytes into the ring, arg = bytes
+    TRACE_FRAME_OK,     // Frame passed its CRC check, arg = sequence number
+    TRACE_FRAME_BAD,    // CRC or length error, arg = bytes dropped to resynchronise
+    TRACE_BUTTON_BEGIN, // Button interrupt entered, arg = GPIO
+    TRACE_BUTTON_END,
+    TRACE_MODE_BEGIN,   // Module mode switch started, arg = mode
+    TRACE_MODE_END,     // Switch finished, arg = 1 if the module reported ready
+    TRACE_TX_FRAME,     // Frame handed to the UART, arg = bytes with the address header
+    TRACE_AUX,          // AUX edge, arg = level
+    TRACE_UI_POST,      // Message queued for the display, arg = characters
+    TRACE_SHOW_BEGIN,   // Display refresh started
+    TRACE_SHOW_END,     // Refresh finished, arg = 1 if the display acknowledged it
+    TRACE_SLEEP_BEGIN,  // Core waits for an interrupt
+    TRACE_SLEEP_END,
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+// One event as kept in RAM
+typedef struct
+{
+    uint32_t time_us; // time_us_32 when recorded
+    uint8_t event;
+    uint8_t core;
+    uint16_t arg;
+} trace_record_t;
+
+_Static_assert(sizeof(trace_record_t) == 8, "trace records are 8 bytes");
+
+#if LORA_TRACE
+#define TRACE(event, arg) trace_record((event), (uint16_t)(arg))
+#else
+#define TRACE(event, arg) ((void)(arg))
+#endif
+
+// Adds an event to the ring of the calling core, safe from interrupts and from both cores. Use TRACE
+void trace_record(trace_event_t event, uint16_t arg);
+
+/**
+*   @brief Prints the rings on stdio, oldest event first, and empties them
+*
+*   Format, one line each, all numbers hex:
+*       trace begin <records> <overwritten>
+*       T <time_us> <event> <core> <arg>
+*       trace end
+*
+*   project/host/trace2json turns it into a Chrome/Perfetto trace.
+*/
+void trace_dump(void);
+
+#endif
@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "tx_queue.h"
+#include "e32_uart.h"
+#include "trace.h"
+
+#include "hardware/sync.h"
+
+// Idle time after a frame, in byte times, so the module closes the packet before the next address header
+#define FRAME_GAP_BYTES 5
+
+typedef struct
+{
+    uint8_t len;
+    uint8_t data[TX_MAX_FRAME];
+} tx_entry_t;
+
+// Free running indices, producers reserve slots with interrupts disabled, the TX engine consumes
+static tx_entry_t queue[TX_QUEUE_DEPTH];
+static volatile uint32_t q_head = 0;
+static volatile uint32_t q_tail = 0;
+
+static volatile tx_queue_stats_t tx_stats;
+
+// Frame owned by the UART while it is being written
+static uint8_t tx_frame[TX_MAX_FRAME];
+
+static uint32_t frame_gap_us;
+static bool awaiting_idle = false;
+static uint32_t idle_since = 0;
+
+// Bytes handed to the module since it last reported an empty buffer
+static size_t inflight = 0;
+static uint32_t rises_at_write = 0;
+
+void tx_queue_init(uint32_t baud)
+{
+    // 10 bits per byte with 8N1
+    frame_gap_us = FRAME_GAP_BYTES * 10 * 1000000u / baud;
+}
+
+bool tx_queue_push(uint8_t addhigh, uint8_t addlow, uint8_t channel, const uint8_t *payload, size_t len)
+{
+    if (len > TX_MAX_PAYLOAD)
+    {
+        tx_stats.dropped++;
+        return false;
+    }
+
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t depth = q_head - q_tail;
+    bool ok = depth < TX_QUEUE_DEPTH;
+
+    if (ok)
+    {
+        tx_entry_t *e = &queue[q_head % TX_QUEUE_DEPTH];
+        e->data[0] = addhigh;
+        e->data[1] = addlow;
+        e->data[2] = channel;
+        memcpy(e->data + TX_ADDR_LEN, payload, len);
+        e->len = TX_ADDR_LEN + len;
+
+        q_head++;
+        tx_stats.queued++;
+        if (depth + 1 > tx_stats.max_depth)
+        {
+            tx_stats.max_depth = depth + 1;
+        }
+    }
+    else
+    {
+        tx_stats.dropped++;
+    }
+
+    restore_interrupts(irq);
+    return ok;
+}
+
+void tx_queue_poll()
+{
+    if (e32_uart_tx_busy())
+    {
+        return;
+    }
+
+    uint32_t now = time_us_32();
+
+    if (awaiting_idle && e32_uart_tx_idle())
+    {
+        awaiting_idle = false;
+        idle_since = now;
+    }
+
+    if (q_head == q_tail || awaiting_idle || now - idle_since < frame_gap_us)
+    {
+        return;
+    }
+
+    int mode = e32_mode();
+    if (e32_mode_poll() != E32_MODE_READY || (mode != NORMAL_MODE && mode != WAKEUP_MODE))
+    {
+        return;
+    }
+
+    // AUX rose after the last frame was written, the module buffer is empty again
+    if (e32_aux_ready() && e32_aux_rise_count() != rises_at_write)
+    {
+        inflight = 0;
+    }
+
+    tx_entry_t *e = &queue[q_tail % TX_QUEUE_DEPTH];
+    if (inflight + e->len > E32_BUFFER_SIZE)
+    {
+        return;
+    }
+
+    size_t len = e->len;
+    memcpy(tx_frame, e->data, len);
+    q_tail++;
+
+    inflight += len;
+    rises_at_write = e32_aux_rise_count();
+    awaiting_idle = true;
+
+    TRACE(TRACE_TX_FRAME, len);
+    e32_uart_tx_start(tx_frame, len);
+    tx_stats.sent++;
+}
+
+size_t tx_queue_depth()
+{
+    return q_head - q_tail;
+}
+
+bool tx_queue_idle()
+{
+    return q_head == q_tail && tx_queue_drained();
+}
+
+bool tx_queue_drained()
+{
+    if (!e32_uart_tx_idle())
+    {
+        return false;
+    }
+    return inflight == 0 || (e32_aux_ready() && e32_aux_rise_count() != rises_at_write);
+}
+
+void tx_queue_get_stats(tx_queue_stats_t *stats)
+{
+    stats->queued = tx_stats.queued;
+    stats->sent = tx_stats.sent;
+    stats->dropped = tx_stats.dropped;
+    stats->max_depth = tx_stats.max_depth;
+}
@@ -0,0 +1,65 @@
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "e32.h"
+
+// Frames waiting for the TX engine
+#define TX_QUEUE_DEPTH 8
+
+// Address header plus payload, kept within one module sub-packet
+#define TX_MAX_FRAME E32_SUBPACKET_SIZE
+#define TX_ADDR_LEN 3
+#define TX_MAX_PAYLOAD (TX_MAX_FRAME - TX_ADDR_LEN)
+
+typedef struct
+{
+    uint32_t queued;    // Frames accepted by tx_queue_push
+    uint32_t sent;      // Frames handed to the UART
+    uint32_t dropped;   // Frames rejected because the queue was full or too long
+    uint32_t max_depth; // Highest number of frames waiting at once
+} tx_queue_stats_t;
+
+/**
+*   @brief Prepares the TX engine
+*   @param baud UART baud rate, sets the idle gap the module needs to end a packet
+*/
+void tx_queue_init(uint32_t baud);
+
+/**
+*   @brief Queues a frame for fixed transmission, safe to call from interrupts
+*   @param addhigh Destination high address
+*   @param addlow Destination low address
+*   @param channel Destination channel
+*   @param payload Message bytes, copied into the queue
+*   @param len Number of message bytes, at most TX_MAX_PAYLOAD
+*   @return false if the frame was dropped
+*/
+bool tx_queue_push(uint8_t addhigh, uint8_t addlow, uint8_t channel, const uint8_t *payload, size_t len);
+
+/**
+*   @brief Hands the next frame to the UART when the module can take it, call from the main loop
+*
+*   A frame starts only when the module is in NORMAL_MODE or WAKEUP_MODE, the
+*   previous frame has been idle on the line long enough to close its packet,
+*   and the bytes given to the module since AUX last reported an empty buffer
+*   still fit into its E32_BUFFER_SIZE buffer.
+*/
+void tx_queue_poll(void);
+
+// Frames currently waiting
+size_t tx_queue_depth(void);
+
+// Nothing waiting, the UART is idle and AUX rose since the last frame, so the module has sent everything
+bool tx_queue_idle(void);
+
+// Like tx_queue_idle but frames may still wait, none is half written or left in the module buffer
+bool tx_queue_drained(void);
+
+// Copies the queue counters
+void tx_queue_get_stats(tx_queue_stats_t *stats);
+
+#endif
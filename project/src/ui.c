@@ -0,0 +1,205 @@
+#include <string.h>
+
+#include "ui.h"
+#include "msg_log.h"
+#include "trace.h"
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#if LORA_DUAL_CORE
+#include "pico/multicore.h"
+#endif
+
+typedef struct
+{
+    uint8_t len;
+    char text[MSG_LOG_TEXT_MAX];
+} ui_msg_t;
+
+// Free running indices, head is only written by the producer and tail only by the consumer
+static ui_msg_t queue[UI_QUEUE_DEPTH];
+static volatile uint32_t q_head = 0;
+static volatile uint32_t q_tail = 0;
+
+// Counters written by the producer and by the consumer, each field has a single writer
+static volatile ui_stats_t ui_stats;
+
+static ssd1306_t *ui_disp = NULL;
+static uint32_t last_frame_us = 0;
+
+// Runs on the display side whenever a refresh finished
+static void on_show(void *user_data, bool ok)
+{
+    const ssd1306_t *disp = user_data;
+    uint32_t us = disp->show_us;
+    int bucket = 0;
+
+    TRACE(TRACE_SHOW_END, ok);
+    if (!ok)
+    {
+        return;
+    }
+
+    while (bucket < UI_SHOW_BUCKETS - 1 && us > (uint32_t)UI_SHOW_BUCKET_US << bucket)
+    {
+        bucket++;
+    }
+    ui_stats.show_hist[bucket]++;
+
+    if (us > ui_stats.show_us_max)
+    {
+        ui_stats.show_us_max = us;
+    }
+}
+
+void ui_init(ssd1306_t *disp)
+{
+    ssd1306_set_show_callback(disp, on_show, disp);
+    msg_log_init(disp);
+    ssd1306_show(disp);
+    last_frame_us = time_us_32();
+
+    // Published last, the consumer starts drawing once it sees the display
+    __dmb();
+    ui_disp = disp;
+}
+
+bool ui_post(const char *text, size_t len)
+{
+    uint32_t head = q_head;
+    uint32_t depth = head - q_tail;
+
+    if (depth >= UI_QUEUE_DEPTH)
+    {
+        ui_stats.dropped++;
+        return false;
+    }
+
+    ui_msg_t *m = &queue[head % UI_QUEUE_DEPTH];
+    m->len = (uint8_t)(len < MSG_LOG_TEXT_MAX ? len : MSG_LOG_TEXT_MAX);
+    memcpy(m->text, text, m->len);
+
+    // Message complete before the consumer can see it
+    __dmb();
+    q_head = head + 1;
+
+    ui_stats.queued++;
+    if (depth)
+    {
+        ui_stats.backlog++;
+    }
+    TRACE(TRACE_UI_POST, m->len);
+    if (depth + 1 > ui_stats.max_depth)
+    {
+        ui_stats.max_depth = depth + 1;
+    }
+
+#if LORA_DUAL_CORE
+    // Wakes core 1 if it waits in ui_core1_main
+    __sev();
+#endif
+    return true;
+}
+
+void ui_poll()
+{
+    if (ui_disp == NULL)
+    {
+        return;
+    }
+
+    uint32_t poll_start = time_us_32();
+    uint32_t tail = q_tail;
+    uint32_t head = q_head;
+    __dmb();
+
+    while (tail != head)
+    {
+        const ui_msg_t *m = &queue[tail % UI_QUEUE_DEPTH];
+        uint32_t start = time_us_32();
+
+        msg_log_add(m->text, m->len);
+
+        uint32_t took = time_us_32() - start;
+        if (took > ui_stats.draw_us_max)
+        {
+            ui_stats.draw_us_max = took;
+        }
+        ui_stats.drawn++;
+
+        // Slot read before the producer may reuse it
+        __dmb();
+        q_tail = ++tail;
+    }
+
+    // Send whatever was drawn once the previous frame has left and the frame budget allows,
+    // without waiting for the I2C transfer. Under bursts frames are merged, reception never waits.
+    if (!ssd1306_show_poll(ui_disp) && ssd1306_is_dirty(ui_disp) &&
+        time_us_32() - last_frame_us >= UI_FRAME_MS * 1000)
+    {
+        last_frame_us = time_us_32();
+        TRACE(TRACE_SHOW_BEGIN, 0);
+        ssd1306_show_async(ui_disp);
+        ui_stats.frames++;
+    }
+
+    uint32_t spent = time_us_32() - poll_start;
+    ui_stats.poll_us += spent;
+    if (spent > ui_stats.poll_us_max)
+    {
+        ui_stats.poll_us_max = spent;
+    }
+}
+
+void ui_core1_main()
+{
+#if LORA_DUAL_CORE
+    // Lets core 0 park this core while it writes flash
+    multicore_lockout_victim_init();
+#endif
+
+    while (1)
+    {
+        ui_poll();
+
+        // A message posted after the check sets the event flag, __wfe then returns at once
+        if (ui_idle())
+        {
+            __wfe();
+        }
+    }
+}
+
+bool ui_idle()
+{
+    return ui_disp == NULL || (q_head == q_tail && !ssd1306_show_poll(ui_disp) && !ssd1306_is_dirty(ui_disp));
+}
+
+size_t ui_queue_depth()
+{
+    return q_head - q_tail;
+}
+
+void ui_get_stats(ui_stats_t *stats)
+{
+    stats->queued = ui_stats.queued;
+    stats->dropped = ui_stats.dropped;
+    stats->max_depth = ui_stats.max_depth;
+    stats->backlog = ui_stats.backlog;
+    stats->poll_us = ui_stats.poll_us;
+    stats->poll_us_max = ui_stats.poll_us_max;
+    stats->drawn = ui_stats.drawn;
+    stats->frames = ui_stats.frames;
+    stats->draw_us_max = ui_stats.draw_us_max;
+    stats->show_us_max = ui_stats.show_us_max;
+    for (int i = 0; i < UI_SHOW_BUCKETS; i++)
+    {
+        stats->show_hist[i] = ui_stats.show_hist[i];
+    }
+
+    // Counted by the display driver on the display side
+    const ssd1306_t *disp = ui_disp;
+    stats->i2c_errors = disp ? disp->i2c_errors : 0;
+    stats->i2c_timeouts = disp ? disp->i2c_timeouts : 0;
+}
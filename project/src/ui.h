@@ -0,0 +1,80 @@
+#ifndef UI_H
+#define UI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ssd1306.h"
+
+// Display and UI on core 1, radio on core 0. Off for the host simulation, which has one core per node
+#ifndef LORA_DUAL_CORE
+#define LORA_DUAL_CORE 1
+#endif
+
+// Messages waiting for the display side, a power of two
+#define UI_QUEUE_DEPTH 16
+
+// Shortest time between two display refreshes, messages drawn in between go out in the same frame
+#define UI_FRAME_MS 50
+
+// Display refresh durations: bucket n counts refreshes up to UI_SHOW_BUCKET_US << n, the last one the longer ones
+#define UI_SHOW_BUCKETS 8
+#define UI_SHOW_BUCKET_US 500
+
+typedef struct
+{
+    uint32_t queued;        // Messages accepted by ui_post
+    uint32_t dropped;       // Messages rejected because the display side fell behind
+    uint32_t max_depth;     // Highest number of messages waiting at once
+    uint32_t backlog;       // Posts that found earlier messages still waiting, the display side was behind
+    uint32_t poll_us;       // Time spent in ui_poll, wraps after about 71 minutes of it
+    uint32_t poll_us_max;   // Longest ui_poll call
+    uint32_t drawn;         // Messages drawn into the display buffer
+    uint32_t frames;        // Display refreshes started
+    uint32_t draw_us_max;   // Longest time spent drawing one message
+    uint32_t show_us_max;   // Longest display refresh
+    uint32_t show_hist[UI_SHOW_BUCKETS];
+    uint32_t i2c_errors;    // Transfers the display did not acknowledge
+    uint32_t i2c_timeouts;  // Transfers aborted after SSD1306_I2C_TIMEOUT_US
+} ui_stats_t;
+
+/**
+*   @brief Hands the display to the UI, nothing else may use it afterwards
+*   @param disp Initialised display, cleared and shown as an empty message log
+*/
+void ui_init(ssd1306_t *disp);
+
+/**
+*   @brief Queues a message for the display, never blocks
+*
+*   Single producer: only the radio side may call it. The queue is lock-free
+*   so producer and consumer can run on different cores.
+*
+*   @param text Message, does not need to be terminated
+*   @param len Number of characters, cut to MSG_LOG_TEXT_MAX
+*   @return false if the queue was full and the message dropped
+*/
+bool ui_post(const char *text, size_t len);
+
+/**
+*   @brief Draws queued messages and refreshes the display within the frame budget
+*
+*   Single consumer: call from the loop that owns the display, core 1 with
+*   ui_core1_main or the main loop. Does nothing before ui_init.
+*/
+void ui_poll(void);
+
+// Entry point of core 1, runs ui_poll and sleeps until the next message whenever the UI is idle
+void ui_core1_main(void);
+
+// Nothing queued, drawn but not shown, or being sent to the display. Call from the display side
+bool ui_idle(void);
+
+// Messages waiting
+size_t ui_queue_depth(void);
+
+// Copies the UI counters
+void ui_get_stats(ui_stats_t *stats);
+
+#endif
@@ -25,6 +25,7 @@ SOFTWARE.
 
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
+#include <hardware/dma.h>
 #include <pico/binary_info.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,17 +35,19 @@ SOFTWARE.
 #include "font.h"
 
 inline static void swap(int32_t *a, int32_t *b) {
-    int32_t *t=a;
+    int32_t t=*a;
     *a=*b;
-    *b=*t;
+    *b=t;
 }
 
-inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, char *name) {
-    switch(i2c_write_blocking(i2c, addr, src, len, false)) {
+inline static void fancy_write(ssd1306_t *p, const uint8_t *src, size_t len, char *name) {
+    switch(i2c_write_timeout_us(p->i2c_i, p->address, src, len, false, SSD1306_I2C_TIMEOUT_US)) {
     case PICO_ERROR_GENERIC:
+        ++p->i2c_errors;
         printf("[%s] addr not acknowledged!\n", name);
         break;
     case PICO_ERROR_TIMEOUT:
+        ++p->i2c_timeouts;
         printf("[%s] timeout!\n", name);
         break;
     default:
@@ -53,9 +56,44 @@ inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src
     }
 }
 
-inline static void ssd1306_write(ssd1306_t *p, uint8_t val) {
-    uint8_t d[2]= {0x00, val};
-    fancy_write(p->i2c_i, p->address, d, 2, "ssd1306_write");
+inline static void ssd1306_mark_dirty(ssd1306_t *p, uint8_t x1, uint8_t p1, uint8_t x2, uint8_t p2) {
+    if(x1<p->dirty_x1) p->dirty_x1=x1;
+    if(x2>p->dirty_x2) p->dirty_x2=x2;
+    if(p1<p->dirty_p1) p->dirty_p1=p1;
+    if(p2>p->dirty_p2) p->dirty_p2=p2;
+}
+
+inline static void ssd1306_mark_clean(ssd1306_t *p) {
+    p->dirty_x1=p->dirty_p1=0xFF;
+    p->dirty_x2=p->dirty_p2=0;
+}
+
+inline static void ssd1306_window_cmds(ssd1306_t *p, uint8_t *cmds) {
+    cmds[0]=SET_COL_ADDR;
+    cmds[1]=p->dirty_x1;
+    cmds[2]=p->dirty_x2;
+    cmds[3]=SET_PAGE_ADDR;
+    cmds[4]=p->dirty_p1;
+    cmds[5]=p->dirty_p2;
+    if(p->width==64) {
+        cmds[1]+=32;
+        cmds[2]+=32;
+    }
+}
+
+void ssd1306_write_cmds(ssd1306_t *p, const uint8_t *cmds, size_t len) {
+    uint8_t d[SSD1306_CMD_BATCH_MAX+1];
+    d[0]=0x00; // Co=0, D/C#=0: all following bytes are commands
+
+    ssd1306_show_wait(p); // bus may still be owned by async show
+
+    while(len) {
+        size_t n=len<SSD1306_CMD_BATCH_MAX?len:SSD1306_CMD_BATCH_MAX;
+        memcpy(d+1, cmds, n);
+        fancy_write(p, d, n+1, "ssd1306_write_cmds");
+        cmds+=n;
+        len-=n;
+    }
 }
 
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance) {
@@ -75,6 +113,25 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
 
     ++(p->buffer);
 
+    // async show sends a copy of the window: control byte, 6 window commands, control byte, data,
+    // then control byte and start line command
+    p->busy=false;
+    p->show_cb=NULL;
+    p->start_line=0;
+    p->start_line_pending=false;
+    p->show_us=0;
+    p->i2c_errors=0;
+    p->i2c_timeouts=0;
+    p->dma_buf=NULL;
+    p->dma_chan=dma_claim_unused_channel(false);
+    if(p->dma_chan>=0 && (p->dma_buf=malloc((p->bufsize+10)*sizeof(uint16_t)))==NULL) {
+        dma_channel_unclaim(p->dma_chan);
+        p->dma_chan=-1;
+    }
+
+    // ram content of the panel is unknown, first show has to send everything
+    ssd1306_invalidate(p);
+
     // from https://github.com/makerportal/rpi-pico-ssd1306
     uint8_t cmds[]= {
         SET_DISP,
@@ -109,47 +166,125 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
         0x00,  // horizontal
     };
 
-    for(size_t i=0; i<sizeof(cmds); ++i)
-        ssd1306_write(p, cmds[i]);
+    ssd1306_write_cmds(p, cmds, sizeof(cmds));
 
     return true;
 }
 
 inline void ssd1306_deinit(ssd1306_t *p) {
+    if(p->dma_chan>=0) {
+        ssd1306_show_wait(p);
+        dma_channel_unclaim(p->dma_chan);
+        free(p->dma_buf);
+    }
     free(p->buffer-1);
 }
 
 inline void ssd1306_poweroff(ssd1306_t *p) {
-    ssd1306_write(p, SET_DISP|0x00);
+    const uint8_t cmds[]= {SET_DISP|0x00};
+    ssd1306_write_cmds(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_poweron(ssd1306_t *p) {
-    ssd1306_write(p, SET_DISP|0x01);
+    const uint8_t cmds[]= {SET_DISP|0x01};
+    ssd1306_write_cmds(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_contrast(ssd1306_t *p, uint8_t val) {
-    ssd1306_write(p, SET_CONTRAST);
-    ssd1306_write(p, val);
+    const uint8_t cmds[]= {SET_CONTRAST, val};
+    ssd1306_write_cmds(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_invert(ssd1306_t *p, uint8_t inv) {
-    ssd1306_write(p, SET_NORM_INV | (inv & 1));
+    const uint8_t cmds[]= {SET_NORM_INV | (inv & 1)};
+    ssd1306_write_cmds(p, cmds, sizeof(cmds));
+}
+
+void ssd1306_set_start_line(ssd1306_t *p, uint8_t line) {
+    line%=p->height;
+    if(line==p->start_line && !p->start_line_pending)
+        return;
+    p->start_line=line;
+    p->start_line_pending=true;
+}
+
+// sends a start line that is still pending, after the window data
+inline static void ssd1306_send_start_line(ssd1306_t *p) {
+    if(!p->start_line_pending)
+        return;
+    const uint8_t cmds[]= {SET_DISP_START_LINE | p->start_line};
+    p->start_line_pending=false;
+    ssd1306_write_cmds(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_clear(ssd1306_t *p) {
     memset(p->buffer, 0, p->bufsize);
+    ssd1306_invalidate(p);
+}
+
+bool ssd1306_is_dirty(ssd1306_t *p) {
+    return p->dirty_x1<=p->dirty_x2 || p->start_line_pending;
+}
+
+inline void ssd1306_invalidate(ssd1306_t *p) {
+    p->dirty_x1=0;
+    p->dirty_x2=p->width-1;
+    p->dirty_p1=0;
+    p->dirty_p2=p->pages-1;
 }
 
 void ssd1306_clear_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
     if(x>=p->width || y>=p->height) return;
 
     p->buffer[x+p->width*(y>>3)]&=~(0x1<<(y&0x07));
+    ssd1306_mark_dirty(p, x, y>>3, x, y>>3);
 }
 
 void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
     if(x>=p->width || y>=p->height) return;
 
     p->buffer[x+p->width*(y>>3)]|=0x1<<(y&0x07); // y>>3==y/8 && y&0x7==y%8
+    ssd1306_mark_dirty(p, x, y>>3, x, y>>3);
+}
+
+// rows y1..y2 (y1<=y2) of one page
+inline static uint8_t ssd1306_page_mask(uint32_t y1, uint32_t y2) {
+    return (uint8_t) ((0xFFu<<(y1&7)) & (0xFFu>>(7-(y2&7))));
+}
+
+// sets or clears the clipped rectangle x1..x2, y1..y2 (inclusive, inside the display) a page byte at a time
+static void ssd1306_fill_rect(ssd1306_t *p, uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, bool on) {
+    const uint32_t p1=y1>>3, p2=y2>>3;
+    uint8_t *row=p->buffer+p->width*p1+x1;
+
+    for(uint32_t page=p1; page<=p2; ++page, row+=p->width) {
+        const uint8_t mask=ssd1306_page_mask(page==p1?y1:0, page==p2?y2:7);
+        if(mask==0xFF)
+            memset(row, on?0xFF:0x00, x2-x1+1);
+        else if(on)
+            for(uint32_t x=0; x<=x2-x1; ++x)
+                row[x]|=mask;
+        else
+            for(uint32_t x=0; x<=x2-x1; ++x)
+                row[x]&=~mask;
+    }
+
+    ssd1306_mark_dirty(p, x1, p1, x2, p2);
+}
+
+// last coordinate of a span of len starting at start, clipped to a display side of size
+static inline uint32_t ssd1306_span_end(uint32_t start, uint32_t len, uint32_t size) {
+    return len>size-start?size-1:start+len-1;
+}
+
+void ssd1306_draw_hline(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width) {
+    if(!width || x>=p->width || y>=p->height) return;
+    ssd1306_fill_rect(p, x, y, ssd1306_span_end(x, width, p->width), y, true);
+}
+
+void ssd1306_draw_vline(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t height) {
+    if(!height || x>=p->width || y>=p->height) return;
+    ssd1306_fill_rect(p, x, y, x, ssd1306_span_end(y, height, p->height), true);
 }
 
 void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
@@ -158,27 +293,67 @@ void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t
         swap(&y1, &y2);
     }
 
+    // axis aligned lines are spans, clipped to the display on the negative side as well
+    if(y1==y2) {
+        if(y1<0 || x2<0) return;
+        if(x1<0) x1=0;
+        ssd1306_draw_hline(p, x1, y1, x2-x1+1);
+        return;
+    }
+
     if(x1==x2) {
         if(y1>y2)
             swap(&y1, &y2);
-        for(int32_t i=y1; i<=y2; ++i)
-            ssd1306_draw_pixel(p, x1, i);
+        if(x1<0 || y2<0) return;
+        if(y1<0) y1=0;
+        ssd1306_draw_vline(p, x1, y1, y2-y1+1);
         return;
     }
 
-    float m=(float) (y2-y1) / (float) (x2-x1);
-
-    for(int32_t i=x1; i<=x2; ++i) {
-        float y=m*(float) (i-x1)+(float) y1;
-        ssd1306_draw_pixel(p, i, (uint32_t) y);
+    // bresenham, integer only. pixels outside the display wrap to large
+    // unsigned coordinates and are skipped, x only grows so the dirty
+    // columns are the first and last pixel drawn
+    const int32_t dx=x2-x1;
+    const int32_t dy=y2>y1?y2-y1:y1-y2;
+    const int32_t sy=y2>y1?1:-1;
+    int32_t err=dx-dy;
+    uint32_t first=UINT32_MAX, last=0;
+    uint8_t p1=0xFF, p2=0;
+
+    for(;;) {
+        if((uint32_t) x1<p->width && (uint32_t) y1<p->height) {
+            const uint8_t page=y1>>3;
+            p->buffer[x1+p->width*page]|=0x1<<(y1&0x07);
+            if(first==UINT32_MAX) first=x1;
+            last=x1;
+            if(page<p1) p1=page;
+            if(page>p2) p2=page;
+        }
+        if(x1==x2 && y1==y2)
+            break;
+        const int32_t e2=2*err;
+        if(e2>-dy) {
+            err-=dy;
+            ++x1;
+        }
+        if(e2<dx) {
+            err+=dx;
+            y1+=sy;
+        }
     }
+
+    if(first!=UINT32_MAX)
+        ssd1306_mark_dirty(p, first, p1, last, p2);
 }
 
 void ssd1306_draw_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-    for(uint32_t i=0; i<width; ++i)
-        for(uint32_t j=0; j<height; ++j)
-            ssd1306_draw_pixel(p, x+i, y+j);
+    if(!width || !height || x>=p->width || y>=p->height) return;
+    ssd1306_fill_rect(p, x, y, ssd1306_span_end(x, width, p->width), ssd1306_span_end(y, height, p->height), true);
+}
 
+void ssd1306_clear_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if(!width || !height || x>=p->width || y>=p->height) return;
+    ssd1306_fill_rect(p, x, y, ssd1306_span_end(x, width, p->width), ssd1306_span_end(y, height, p->height), false);
 }
 
 void ssd1306_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
@@ -188,24 +363,143 @@ void ssd1306_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t wi
     ssd1306_draw_line(p, x+width, y, x+width, y+height);
 }
 
+/*
+ * font columns are 8 rows per byte with bit 0 at the top, the same layout as a
+ * display page, so glyphs are ORed into the buffer a column at a time instead
+ * of pixel by pixel. bits is a column of pixels starting at row y, it covers
+ * one page if y is page aligned and spills into the next pages otherwise.
+ * returns false if nothing was drawn.
+ */
+inline static bool ssd1306_or_column(ssd1306_t *p, uint32_t x, uint32_t y, uint64_t bits, uint8_t *p1, uint8_t *p2) {
+    uint32_t page=y>>3;
+    const uint32_t shift=y&7;
+    uint8_t *dst=p->buffer+x+p->width*page;
+    bool drawn=false;
+
+    if(!bits || x>=p->width)
+        return false;
+
+    uint8_t b=(uint8_t) (bits<<shift);
+    bits>>=8-shift;
+    for(;;) {
+        if(page>=p->pages)
+            break;
+        if(b) {
+            *dst|=b;
+            if(page<*p1) *p1=page;
+            if(page>*p2) *p2=page;
+            drawn=true;
+        }
+        if(!bits)
+            break;
+        b=(uint8_t) bits;
+        bits>>=8;
+        dst+=p->width;
+        ++page;
+    }
+    return drawn;
+}
+
+// every row of a font column repeated scale times, scale<=8
+inline static uint64_t ssd1306_expand_column(uint8_t line, uint32_t scale) {
+    const uint64_t run=(1ull<<scale)-1;
+    uint64_t bits=0;
+    for(uint32_t j=0; line; ++j, line>>=1)
+        if(line&1)
+            bits|=run<<(j*scale);
+    return bits;
+}
+
 void ssd1306_draw_char_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, char c) {
     if(c<font[3]||c>font[4])
         return;
 
     uint32_t parts_per_line=(font[0]>>3)+((font[0]&7)>0);
-    for(uint8_t w=0; w<font[1]; ++w) { // width
-        uint32_t pp=(c-font[3])*font[1]*parts_per_line+w*parts_per_line+5;
+    const uint8_t *col=font+(c-font[3])*font[1]*parts_per_line+5;
+
+    if(scale>8) {
+        for(uint8_t w=0; w<font[1]; ++w) { // width
+            for(uint32_t lp=0; lp<parts_per_line; ++lp) {
+                uint8_t line=*col++;
+
+                for(int8_t j=0; j<8; ++j, line>>=1) {
+                    if(line & 1)
+                        ssd1306_draw_square(p, x+w*scale, y+((lp<<3)+j)*scale, scale, scale);
+                }
+            }
+        }
+        return;
+    }
+
+    uint32_t x1=UINT32_MAX, x2=0;
+    uint8_t p1=0xFF, p2=0;
+
+    if(scale==1) {
+        const uint32_t cols=x>=p->width?0:(p->width-x<font[1]?p->width-x:font[1]);
+
         for(uint32_t lp=0; lp<parts_per_line; ++lp) {
-            uint8_t line=font[pp];
+            const uint32_t yp=y+(lp<<3), page=yp>>3, shift=yp&7;
+            if(page>=p->pages)
+                break;
+
+            // page aligned glyphs go into one page, others are split over two
+            uint8_t *dst=p->buffer+x+p->width*page;
+            uint8_t *next=shift && page+1<p->pages?dst+p->width:NULL;
+            const uint8_t *src=col+lp;
+            uint8_t hi=0, lo=0;
+
+            for(uint32_t w=0; w<cols; ++w, src+=parts_per_line) {
+                const uint8_t line=*src;
+                if(!line)
+                    continue;
+                const uint8_t a=(uint8_t) (line<<shift);
+                const uint8_t b=next?(uint8_t) (line>>(8-shift)):0;
+                if(!(a|b))
+                    continue;
+                dst[w]|=a;
+                hi|=a;
+                if(b) {
+                    next[w]|=b;
+                    lo|=b;
+                }
+                if(x+w<x1) x1=x+w;
+                x2=x+w;
+            }
 
-            for(int8_t j=0; j<8; ++j, line>>=1) {
-                if(line & 1)
-                    ssd1306_draw_square(p, x+w*scale, y+((lp<<3)+j)*scale, scale, scale);
+            if(hi) {
+                if(page<p1) p1=page;
+                if(page>p2) p2=page;
             }
+            if(lo) {
+                if(page<p1) p1=page;
+                p2=page+1;
+            }
+        }
+
+        if(x1<=x2)
+            ssd1306_mark_dirty(p, x1, p1, x2, p2);
+        return;
+    }
 
-            ++pp;
+    for(uint8_t w=0; w<font[1]; ++w) {
+        for(uint32_t lp=0; lp<parts_per_line; ++lp) {
+            const uint8_t line=*col++;
+            const uint32_t yp=y+(lp<<3)*scale;
+
+            // expanded once, copied to the scale columns it covers
+            const uint64_t bits=ssd1306_expand_column(line, scale);
+            for(uint32_t i=0; i<scale; ++i) {
+                const uint32_t xs=x+w*scale+i;
+                if(ssd1306_or_column(p, xs, yp, bits, &p1, &p2)) {
+                    if(xs<x1) x1=xs;
+                    if(xs>x2) x2=xs;
+                }
+            }
         }
     }
+
+    if(x1<=x2)
+        ssd1306_mark_dirty(p, x1, p1, x2, p2);
 }
 
 void ssd1306_draw_string_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, const char *s) {
@@ -286,16 +580,163 @@ inline void ssd1306_bmp_show_image(ssd1306_t *p, const uint8_t *data, const long
 }
 
 void ssd1306_show(ssd1306_t *p) {
-    uint8_t payload[]= {SET_COL_ADDR, 0, p->width-1, SET_PAGE_ADDR, 0, p->pages-1};
-    if(p->width==64) {
-        payload[1]+=32;
-        payload[2]+=32;
+    if(p->dma_chan>=0) {
+        ssd1306_show_wait(p);
+        ssd1306_show_async(p);
+        ssd1306_show_wait(p);
+        return;
+    }
+
+    if(p->dirty_x1>p->dirty_x2) { // nothing drawn since last show
+        ssd1306_send_start_line(p);
+        return;
+    }
+
+    const uint8_t x1=p->dirty_x1, x2=p->dirty_x2;
+    const uint8_t p1=p->dirty_p1, p2=p->dirty_p2;
+    const uint32_t start_us=time_us_32();
+
+    uint8_t payload[6];
+    ssd1306_window_cmds(p, payload);
+    ssd1306_write_cmds(p, payload, sizeof(payload));
+
+    // the data of the window is sent from the buffer itself, the byte in front
+    // of each run is borrowed for the 0x40 control byte and restored afterwards.
+    // the controller keeps its ram pointer between transfers, so every page of
+    // the window can go in its own transfer.
+    const size_t cols=x2-x1+1;
+    const uint8_t runs=cols==p->width?1:p2-p1+1;
+    const size_t run_len=cols==p->width?cols*(p2-p1+1):cols;
+
+    for(uint8_t r=0; r<runs; ++r) {
+        uint8_t *start=p->buffer+p->width*(p1+r)+x1-1;
+        uint8_t saved=*start;
+        *start=0x40;
+        fancy_write(p, start, run_len+1, "ssd1306_show");
+        *start=saved;
+    }
+
+    ssd1306_mark_clean(p);
+    ssd1306_send_start_line(p);
+    p->show_us=time_us_32()-start_us;
+}
+
+bool ssd1306_show_async(ssd1306_t *p) {
+    if(p->dma_chan<0) {
+        const uint32_t failed=p->i2c_errors+p->i2c_timeouts;
+        ssd1306_show(p);
+        if(p->show_cb)
+            p->show_cb(p->show_cb_data, p->i2c_errors+p->i2c_timeouts==failed);
+        return true;
+    }
+
+    if(ssd1306_show_poll(p))
+        return false;
+
+    const bool dirty=p->dirty_x1<=p->dirty_x2;
+    if(!dirty && !p->start_line_pending)
+        return true;
+
+    // one transfer: window commands, repeated start, window data, repeated
+    // start, start line command, stop. every byte becomes a data_cmd word so
+    // restart/stop can be set per byte.
+    uint16_t *d=p->dma_buf;
+
+    if(dirty) {
+        uint8_t cmds[6];
+        ssd1306_window_cmds(p, cmds);
+
+        *d++=0x00;
+        for(size_t i=0; i<sizeof(cmds); ++i)
+            *d++=cmds[i];
+        *d++=I2C_IC_DATA_CMD_RESTART_BITS|0x40;
+
+        for(uint8_t page=p->dirty_p1; page<=p->dirty_p2; ++page) {
+            const uint8_t *src=p->buffer+p->width*page+p->dirty_x1;
+            for(uint8_t x=p->dirty_x1; x<=p->dirty_x2; ++x)
+                *d++=*src++;
+        }
+    }
+
+    if(p->start_line_pending) {
+        const uint16_t restart=dirty?I2C_IC_DATA_CMD_RESTART_BITS:0;
+        *d++=restart|0x00;
+        *d++=SET_DISP_START_LINE|p->start_line;
+        p->start_line_pending=false;
+    }
+    d[-1]|=I2C_IC_DATA_CMD_STOP_BITS;
+
+    ssd1306_mark_clean(p);
+
+    i2c_hw_t *hw=i2c_get_hw(p->i2c_i);
+    hw->enable=0;
+    hw->tar=p->address;
+    hw->enable=1;
+    (void) hw->clr_stop_det;
+    (void) hw->clr_tx_abrt;
+
+    dma_channel_config c=dma_channel_get_default_config(p->dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(p->i2c_i, true));
+
+    p->busy=true;
+    p->show_start_us=time_us_32();
+    dma_channel_configure(p->dma_chan, &c, &hw->data_cmd, p->dma_buf, d-p->dma_buf, true);
+
+    return true;
+}
+
+bool ssd1306_show_poll(ssd1306_t *p) {
+    if(!p->busy)
+        return false;
+
+    i2c_hw_t *hw=i2c_get_hw(p->i2c_i);
+    const uint32_t raw=hw->raw_intr_stat;
+    bool ok;
+
+    if(raw&I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        // fifo is flushed on abort, stop feeding it and resend everything next time
+        dma_channel_abort(p->dma_chan);
+        (void) hw->clr_tx_abrt;
+        ++p->i2c_errors;
+        printf("[ssd1306_show_async] addr not acknowledged!\n");
+        ssd1306_invalidate(p);
+        p->start_line_pending=true;
+        ok=false;
+    } else if(!dma_channel_is_busy(p->dma_chan) && (raw&I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) {
+        p->show_us=time_us_32()-p->show_start_us;
+        ok=true;
+    } else if(time_us_32()-p->show_start_us>=SSD1306_I2C_TIMEOUT_US) {
+        // bus stuck, disabling the block drops the transfer and flushes the fifo
+        dma_channel_abort(p->dma_chan);
+        hw->enable=0;
+        hw->enable=1;
+        ++p->i2c_timeouts;
+        printf("[ssd1306_show_async] timeout!\n");
+        ssd1306_invalidate(p);
+        p->start_line_pending=true;
+        ok=false;
+    } else {
+        return true;
     }
 
-    for(size_t i=0; i<sizeof(payload); ++i)
-        ssd1306_write(p, payload[i]);
+    (void) hw->clr_stop_det;
+    p->busy=false;
+
+    if(p->show_cb)
+        p->show_cb(p->show_cb_data, ok);
 
-    *(p->buffer-1)=0x40;
+    return false;
+}
+
+void ssd1306_show_wait(ssd1306_t *p) {
+    while(ssd1306_show_poll(p))
+        tight_loop_contents();
+}
 
-    fancy_write(p->i2c_i, p->address, p->buffer-1, p->bufsize+1, "ssd1306_show");
+void ssd1306_set_show_callback(ssd1306_t *p, ssd1306_show_cb_t cb, void *user_data) {
+    p->show_cb=cb;
+    p->show_cb_data=user_data;
 }
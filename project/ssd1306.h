@@ -33,6 +33,24 @@ SOFTWARE.
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
 
+/**
+*	@brief max commands sent in one i2c transaction by ssd1306_write_cmds, longer sequences are split
+*/
+#define SSD1306_CMD_BATCH_MAX 32
+
+/**
+*	@brief longest time a transfer may take, a full frame needs about 25ms at 400kHz. a bus held low is reset after it
+*/
+#define SSD1306_I2C_TIMEOUT_US 100000
+
+/**
+*	@brief called when an asynchronous show finished
+*
+*	@param[in] user_data : pointer given to ssd1306_set_show_callback
+*	@param[in] ok : false if the display did not acknowledge the transfer or it timed out
+*/
+typedef void (*ssd1306_show_cb_t)(void *user_data, bool ok);
+
 /**
 *	@brief defines commands used in ssd1306
 */
@@ -68,6 +86,21 @@ typedef struct {
     bool external_vcc; 	/**< whether display uses external vcc */ 
     uint8_t *buffer;	/**< display buffer */
     size_t bufsize;		/**< buffer size */
+    uint8_t dirty_x1;	/**< first changed column since last show (dirty_x1>dirty_x2 when clean) */
+    uint8_t dirty_x2;	/**< last changed column since last show */
+    uint8_t dirty_p1;	/**< first changed page since last show */
+    uint8_t dirty_p2;	/**< last changed page since last show */
+    uint16_t *dma_buf;	/**< copy of the window being sent, as i2c data_cmd words (second buffer for async show) */
+    int dma_chan;		/**< dma channel used by async show, -1 if none could be claimed */
+    volatile bool busy;	/**< async show in progress */
+    ssd1306_show_cb_t show_cb;	/**< called when async show finished */
+    void *show_cb_data;	/**< passed to show_cb */
+    uint8_t start_line;	/**< ram line shown at the top of the panel */
+    bool start_line_pending;	/**< start_line not sent yet, goes out with the next show */
+    uint32_t show_start_us;	/**< time the async show in progress was started */
+    uint32_t show_us;	/**< duration of the last show that completed */
+    uint32_t i2c_errors;	/**< transfers the display did not acknowledge */
+    uint32_t i2c_timeouts;	/**< transfers that did not finish within SSD1306_I2C_TIMEOUT_US */
 } ssd1306_t;
 
 /**
@@ -93,6 +126,16 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
 */
 void ssd1306_deinit(ssd1306_t *p);
 
+/**
+*	@brief send a sequence of commands (with their arguments) in one i2c transaction
+*
+*	@param[in] p : instance of display
+*	@param[in] cmds : command bytes
+*	@param[in] len : number of command bytes
+*
+*/
+void ssd1306_write_cmds(ssd1306_t *p, const uint8_t *cmds, size_t len);
+
 /**
 *	@brief turn off display
 *
@@ -130,11 +173,82 @@ void ssd1306_invert(ssd1306_t *p, uint8_t inv);
 /**
 	@brief display buffer, should be called on change
 
+	only the window of columns/pages touched by the draw functions since the
+	last call is transferred. does nothing if the buffer did not change.
+
 	@param[in] p : instance of display
 
 */
 void ssd1306_show(ssd1306_t *p);
 
+/**
+	@brief start sending changed part of buffer with dma and return immediately
+
+	the changed window is copied into a second buffer first, so drawing can
+	continue while the transfer runs. call ssd1306_show_poll from the main loop
+	to finish the transfer. falls back to ssd1306_show if no dma channel is available,
+	the show callback then runs before it returns.
+
+	@param[in] p : instance of display
+
+	@return bool.
+	@retval true if the frame was taken (transfer started or nothing to send)
+	@retval false if the previous transfer is still running, buffer stays marked as changed
+*/
+bool ssd1306_show_async(ssd1306_t *p);
+
+/**
+	@brief check on async show, runs the show callback once the transfer finished
+
+	a transfer still running after SSD1306_I2C_TIMEOUT_US is aborted and counted
+	in i2c_timeouts, everything is sent again with the next show.
+
+	@param[in] p : instance of display
+
+	@return bool.
+	@retval true while a transfer is in progress
+	@retval false if idle
+*/
+bool ssd1306_show_poll(ssd1306_t *p);
+
+/**
+	@brief block until async show finished
+
+	@param[in] p : instance of display
+
+*/
+void ssd1306_show_wait(ssd1306_t *p);
+
+/**
+	@brief set function called when async show finished
+
+	@param[in] p : instance of display
+	@param[in] cb : callback, NULL to disable
+	@param[in] user_data : passed to cb
+
+*/
+void ssd1306_set_show_callback(ssd1306_t *p, ssd1306_show_cb_t cb, void *user_data);
+
+/**
+	@brief check whether a show would send anything
+
+	@param[in] p : instance of display
+
+	@return bool.
+	@retval true if the buffer or the start line changed since the last show
+*/
+bool ssd1306_is_dirty(ssd1306_t *p);
+
+/**
+	@brief mark whole display buffer as changed
+
+	use after writing to buffer directly, so the next ssd1306_show transfers the full frame
+
+	@param[in] p : instance of display
+
+*/
+void ssd1306_invalidate(ssd1306_t *p);
+
 /**
 	@brief clear display buffer
 
@@ -143,6 +257,19 @@ void ssd1306_show(ssd1306_t *p);
 */
 void ssd1306_clear(ssd1306_t *p);
 
+/**
+	@brief set the ram line shown at the top of the panel (display start line)
+
+	scrolls the whole display without touching the buffer. the command is sent
+	by the next show after the changed part of the buffer, so content drawn
+	into the lines that scroll in appears together with the scroll.
+
+	@param[in] p : instance of display
+	@param[in] line : ram line, taken modulo the display height
+
+*/
+void ssd1306_set_start_line(ssd1306_t *p, uint8_t line);
+
 /**
 	@brief clear pixel on buffer
 
@@ -162,7 +289,27 @@ void ssd1306_clear_pixel(ssd1306_t *p, uint32_t x, uint32_t y);
 void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y);
 
 /**
-	@brief draw pixel on buffer
+	@brief draw horizontal line, whole page bytes are written at once
+
+	@param[in] p : instance of display
+	@param[in] x : x position of starting point
+	@param[in] y : y position
+	@param[in] width : length of line in pixels
+*/
+void ssd1306_draw_hline(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width);
+
+/**
+	@brief draw vertical line, whole page bytes are written at once
+
+	@param[in] p : instance of display
+	@param[in] x : x position
+	@param[in] y : y position of starting point
+	@param[in] height : length of line in pixels
+*/
+void ssd1306_draw_vline(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t height);
+
+/**
+	@brief draw line on buffer, integer only (bresenham)
 
 	@param[in] p : instance of display
 	@param[in] x1 : x position of starting point
@@ -183,6 +330,17 @@ void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t
 */
 void ssd1306_draw_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 
+/**
+	@brief clear square at given position with given size
+
+	@param[in] p : instance of display
+	@param[in] x : x position of starting point
+	@param[in] y : y position of starting point
+	@param[in] width : width of square
+	@param[in] height : height of square
+*/
+void ssd1306_clear_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
 /**
 	@brief draw empty square at given position with given size
 